@@ -0,0 +1,348 @@
+#ifndef BITMAPINDEX_H
+#define BITMAPINDEX_H
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cctype>
+
+using namespace std;
+
+// Roaring-style compressed bitmap over 32-bit values. Values are split by
+// their high 16 bits into containers; a container is a sorted uint16 array
+// while sparse and switches to a 65536-bit bitset once it passes 4096 values.
+class RoaringBitmap {
+private:
+    static constexpr size_t ARRAY_LIMIT = 4096;
+    static constexpr size_t BITSET_WORDS = 65536 / 64;
+
+    struct Container {
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        vector<uint16_t> array; // sorted values while sparse
+        vector<uint64_t> bits;  // BITSET_WORDS words once dense
+
+        bool isDense() const { return !bits.empty(); }
+
+        bool contains(uint16_t low) const {
+            if (isDense()) return (bits[low >> 6] >> (low & 63)) & 1;
+            return binary_search(array.begin(), array.end(), low);
+        }
+
+        void toBitset() {
+            bits.assign(BITSET_WORDS, 0);
+            for (uint16_t v : array) bits[v >> 6] |= 1ULL << (v & 63);
+            array.clear();
+            array.shrink_to_fit();
+        }
+
+        // Shrink a bitset back to an array if it became sparse
+        void normalize() {
+            if (!isDense() || cardinality > ARRAY_LIMIT) return;
+            array.clear();
+            array.reserve(cardinality);
+            for (size_t w = 0; w < BITSET_WORDS; w++) {
+                uint64_t word = bits[w];
+                while (word) {
+                    array.push_back(static_cast<uint16_t>(w * 64 + __builtin_ctzll(word)));
+                    word &= word - 1;
+                }
+            }
+            bits.clear();
+            bits.shrink_to_fit();
+        }
+
+        void add(uint16_t low) {
+            if (isDense()) {
+                uint64_t& word = bits[low >> 6];
+                uint64_t mask = 1ULL << (low & 63);
+                if (!(word & mask)) {
+                    word |= mask;
+                    cardinality++;
+                }
+                return;
+            }
+            // Appending in ascending order is the common (load-time) case
+            if (array.empty() || array.back() < low) {
+                array.push_back(low);
+            } else {
+                auto it = lower_bound(array.begin(), array.end(), low);
+                if (*it == low) return;
+                array.insert(it, low);
+            }
+            cardinality++;
+            if (cardinality > ARRAY_LIMIT) toBitset();
+        }
+    };
+
+    vector<Container> containers; // sorted by key
+
+    const Container* find(uint16_t key) const {
+        auto it = lower_bound(containers.begin(), containers.end(), key,
+                              [](const Container& c, uint16_t k) { return c.key < k; });
+        return (it != containers.end() && it->key == key) ? &*it : nullptr;
+    }
+
+    static Container intersect(const Container& a, const Container& b) {
+        Container out;
+        out.key = a.key;
+        if (a.isDense() && b.isDense()) {
+            out.bits.resize(BITSET_WORDS);
+            for (size_t w = 0; w < BITSET_WORDS; w++) {
+                out.bits[w] = a.bits[w] & b.bits[w];
+                out.cardinality += __builtin_popcountll(out.bits[w]);
+            }
+            out.normalize();
+        } else if (a.isDense() || b.isDense()) {
+            const Container& sparse = a.isDense() ? b : a;
+            const Container& dense = a.isDense() ? a : b;
+            for (uint16_t v : sparse.array) {
+                if (dense.contains(v)) out.array.push_back(v);
+            }
+            out.cardinality = out.array.size();
+        } else {
+            set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                             back_inserter(out.array));
+            out.cardinality = out.array.size();
+        }
+        return out;
+    }
+
+    static Container unite(const Container& a, const Container& b) {
+        Container out;
+        out.key = a.key;
+        if (!a.isDense() && !b.isDense() && a.cardinality + b.cardinality <= ARRAY_LIMIT) {
+            set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                      back_inserter(out.array));
+            out.cardinality = out.array.size();
+            return out;
+        }
+        out.bits.assign(BITSET_WORDS, 0);
+        for (const Container* c : {&a, &b}) {
+            if (c->isDense()) {
+                for (size_t w = 0; w < BITSET_WORDS; w++) out.bits[w] |= c->bits[w];
+            } else {
+                for (uint16_t v : c->array) out.bits[v >> 6] |= 1ULL << (v & 63);
+            }
+        }
+        for (uint64_t word : out.bits) out.cardinality += __builtin_popcountll(word);
+        out.normalize();
+        return out;
+    }
+
+public:
+    void add(uint32_t value) {
+        uint16_t key = value >> 16;
+        if (containers.empty() || containers.back().key < key) {
+            containers.emplace_back();
+            containers.back().key = key;
+            containers.back().add(value & 0xFFFF);
+            return;
+        }
+        auto it = lower_bound(containers.begin(), containers.end(), key,
+                              [](const Container& c, uint16_t k) { return c.key < k; });
+        if (it == containers.end() || it->key != key) {
+            it = containers.emplace(it);
+            it->key = key;
+        }
+        it->add(value & 0xFFFF);
+    }
+
+    bool contains(uint32_t value) const {
+        const Container* c = find(value >> 16);
+        return c && c->contains(value & 0xFFFF);
+    }
+
+    size_t cardinality() const {
+        size_t total = 0;
+        for (const auto& c : containers) total += c.cardinality;
+        return total;
+    }
+
+    bool empty() const { return containers.empty(); }
+
+    size_t sizeInBytes() const {
+        size_t bytes = 0;
+        for (const auto& c : containers) {
+            bytes += sizeof(Container) + c.array.size() * sizeof(uint16_t) + c.bits.size() * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+    // Visit every value in ascending order
+    template <typename F>
+    void forEach(F&& f) const {
+        for (const auto& c : containers) {
+            uint32_t high = static_cast<uint32_t>(c.key) << 16;
+            if (c.isDense()) {
+                for (size_t w = 0; w < BITSET_WORDS; w++) {
+                    uint64_t word = c.bits[w];
+                    while (word) {
+                        f(high | static_cast<uint32_t>(w * 64 + __builtin_ctzll(word)));
+                        word &= word - 1;
+                    }
+                }
+            } else {
+                for (uint16_t v : c.array) f(high | v);
+            }
+        }
+    }
+
+    static RoaringBitmap intersect(const RoaringBitmap& a, const RoaringBitmap& b) {
+        RoaringBitmap out;
+        size_t i = 0, j = 0;
+        while (i < a.containers.size() && j < b.containers.size()) {
+            uint16_t ka = a.containers[i].key, kb = b.containers[j].key;
+            if (ka < kb) {
+                i++;
+            } else if (kb < ka) {
+                j++;
+            } else {
+                Container c = intersect(a.containers[i++], b.containers[j++]);
+                if (c.cardinality > 0) out.containers.push_back(std::move(c));
+            }
+        }
+        return out;
+    }
+
+    static RoaringBitmap unite(const RoaringBitmap& a, const RoaringBitmap& b) {
+        RoaringBitmap out;
+        size_t i = 0, j = 0;
+        while (i < a.containers.size() || j < b.containers.size()) {
+            if (j == b.containers.size() || (i < a.containers.size() && a.containers[i].key < b.containers[j].key)) {
+                out.containers.push_back(a.containers[i++]);
+            } else if (i == a.containers.size() || b.containers[j].key < a.containers[i].key) {
+                out.containers.push_back(b.containers[j++]);
+            } else {
+                out.containers.push_back(unite(a.containers[i++], b.containers[j++]));
+            }
+        }
+        return out;
+    }
+};
+
+// Constraints for a filtered recommendation query; defaults match everything
+struct MovieFilter {
+    vector<string> genres; // movie must carry every listed genre
+    int minYear = INT_MIN;
+    int maxYear = INT_MAX;
+    int minRatings = 0;
+
+    bool empty() const {
+        return genres.empty() && minYear == INT_MIN && maxYear == INT_MAX && minRatings <= 0;
+    }
+};
+
+// Secondary indexes over movie slots: genre, release year and rating count.
+// Rating counts use cumulative buckets ("at least T ratings"), so any
+// threshold is one bitmap plus a refinement inside the boundary bucket.
+class MovieFilterIndex {
+private:
+    unordered_map<string, RoaringBitmap> byGenre;
+    map<int, RoaringBitmap> byYear;
+    vector<pair<uint32_t, RoaringBitmap>> byMinRatings; // ascending thresholds
+    vector<uint32_t> ratingCounts;                      // movie slot -> rating count
+    RoaringBitmap all;
+
+public:
+    // Release year from a MovieLens title such as "Heat (1995)"; 0 if absent
+    static int parseYear(const string& title) {
+        size_t end = title.find_last_not_of(" \t\r");
+        if (end == string::npos || end < 5 || title[end] != ')' || title[end - 5] != '(') return 0;
+        int year = 0;
+        for (size_t i = end - 4; i < end; i++) {
+            if (!isdigit(static_cast<unsigned char>(title[i]))) return 0;
+            year = year * 10 + (title[i] - '0');
+        }
+        return year;
+    }
+
+    // Register a movie; slots should be added in ascending order
+    void addMovie(uint32_t slot, const vector<string>& genres, const string& title) {
+        all.add(slot);
+        for (const auto& g : genres) byGenre[g].add(slot);
+        int year = parseYear(title);
+        if (year > 0) byYear[year].add(slot);
+    }
+
+    // Build the rating-count buckets once ratings are loaded
+    void setRatingCounts(vector<uint32_t> counts) {
+        ratingCounts = std::move(counts);
+        byMinRatings.clear();
+        for (uint32_t threshold : {1u, 5u, 10u, 25u, 50u, 100u, 250u, 500u, 1000u, 5000u, 10000u}) {
+            RoaringBitmap bucket;
+            for (uint32_t slot = 0; slot < ratingCounts.size(); slot++) {
+                if (ratingCounts[slot] >= threshold) bucket.add(slot);
+            }
+            byMinRatings.push_back({threshold, std::move(bucket)});
+        }
+    }
+
+    // Movie slots satisfying every constraint in the filter
+    RoaringBitmap resolve(const MovieFilter& filter) const {
+        vector<const RoaringBitmap*> parts;
+        RoaringBitmap years;
+        static const RoaringBitmap none;
+
+        for (const auto& g : filter.genres) {
+            auto it = byGenre.find(g);
+            if (it == byGenre.end()) return none;
+            parts.push_back(&it->second);
+        }
+
+        if (filter.minYear != INT_MIN || filter.maxYear != INT_MAX) {
+            for (auto it = byYear.lower_bound(filter.minYear);
+                 it != byYear.end() && it->first <= filter.maxYear; ++it) {
+                years = RoaringBitmap::unite(years, it->second);
+            }
+            parts.push_back(&years);
+        }
+
+        // Largest bucket threshold not above the requested minimum
+        uint32_t minRatings = filter.minRatings > 0 ? filter.minRatings : 0;
+        bool refine = false;
+        if (minRatings > 0) {
+            const RoaringBitmap* bucket = &all;
+            uint32_t covered = 0;
+            for (const auto& [threshold, bitmap] : byMinRatings) {
+                if (threshold > minRatings) break;
+                bucket = &bitmap;
+                covered = threshold;
+            }
+            parts.push_back(bucket);
+            refine = covered < minRatings;
+        }
+
+        if (parts.empty()) return all;
+
+        // Intersect smallest first so intermediate results stay small
+        sort(parts.begin(), parts.end(),
+             [](const RoaringBitmap* a, const RoaringBitmap* b) { return a->cardinality() < b->cardinality(); });
+        RoaringBitmap result = *parts[0];
+        for (size_t i = 1; i < parts.size() && !result.empty(); i++) {
+            result = RoaringBitmap::intersect(result, *parts[i]);
+        }
+
+        if (refine) {
+            RoaringBitmap exact;
+            result.forEach([&](uint32_t slot) {
+                if (ratingCounts[slot] >= minRatings) exact.add(slot);
+            });
+            result = std::move(exact);
+        }
+        return result;
+    }
+
+    size_t sizeInBytes() const {
+        size_t bytes = all.sizeInBytes();
+        for (const auto& [g, b] : byGenre) bytes += b.sizeInBytes();
+        for (const auto& [y, b] : byYear) bytes += b.sizeInBytes();
+        for (const auto& [t, b] : byMinRatings) bytes += b.sizeInBytes();
+        return bytes;
+    }
+};
+
+#endif //BITMAPINDEX_H
@@ -0,0 +1,258 @@
+#ifndef COMPRESSEDRATINGS_H
+#define COMPRESSEDRATINGS_H
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include "DenseStorage.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Rating rows compressed for the similarity scan. Each row's sorted column
+// ids are cut into blocks of 128:
+//   - full blocks store deltas against the id four positions back (D4),
+//     bit-packed at the block's width in 4 interleaved lanes, so a block
+//     unpacks and prefix-sums four ids per SSE2 instruction;
+//   - a row's final partial block is delta-coded and packed sequentially.
+// Ratings are 4-bit half-star codes (rating * 2), two per byte. Every block
+// keeps its last id as the next block's delta base, so entryAt decodes one block.
+class CompressedRatingMatrix {
+public:
+    static constexpr uint32_t BLOCK = 128;
+
+private:
+    struct BlockInfo {
+        uint32_t lastId;     // largest id in the block, the next block's delta base
+        uint32_t dataOffset; // first packed word
+        uint32_t width;      // bits per delta
+    };
+
+    vector<uint32_t> entryOffsets; // row -> first entry (rows + 1)
+    vector<uint32_t> blockOffsets; // row -> first block (rows + 1)
+    vector<uint32_t> codeOffsets;  // row -> first byte of rating codes
+    vector<BlockInfo> blocks;
+    vector<uint32_t> packed;
+    vector<uint8_t> codes;
+
+    static uint32_t bitWidth(uint32_t v) {
+        uint32_t w = 0;
+        while (v) {
+            w++;
+            v >>= 1;
+        }
+        return w;
+    }
+
+    static uint32_t lowMask(uint32_t width) {
+        return width >= 32 ? 0xFFFFFFFFu : (1u << width) - 1;
+    }
+
+    // Append count values of `width` bits, lane-interleaved with stride 4 when
+    // `lanes` is set (value i goes to lane i % 4), sequential otherwise
+    void pack(const uint32_t* values, uint32_t count, uint32_t width, bool lanes) {
+        size_t base = packed.size();
+        uint32_t perStream = lanes ? count / 4 : count;
+        uint32_t streams = lanes ? 4 : 1;
+        uint32_t words = (perStream * width + 31) / 32;
+        packed.resize(base + static_cast<size_t>(words) * streams, 0);
+        if (width == 0) return;
+
+        for (uint32_t stream = 0; stream < streams; stream++) {
+            for (uint32_t j = 0; j < perStream; j++) {
+                uint32_t v = values[lanes ? j * 4 + stream : j];
+                uint32_t bit = j * width;
+                uint32_t word = bit / 32, shift = bit % 32;
+                packed[base + static_cast<size_t>(word) * streams + stream] |= v << shift;
+                if (shift + width > 32) {
+                    packed[base + static_cast<size_t>(word + 1) * streams + stream] |= v >> (32 - shift);
+                }
+            }
+        }
+    }
+
+    // Full block: unpack 4 lanes at a time and add to the previous group of ids
+    static void decodeFullBlock(const uint32_t* in, uint32_t width, uint32_t previous, uint32_t* out) {
+#if defined(__SSE2__)
+        __m128i prev = _mm_set1_epi32(static_cast<int>(previous));
+        if (width == 0) {
+            for (uint32_t j = 0; j < BLOCK / 4; j++) _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * j), prev);
+            return;
+        }
+        __m128i mask = _mm_set1_epi32(static_cast<int>(lowMask(width)));
+        uint32_t bit = 0;
+        for (uint32_t j = 0; j < BLOCK / 4; j++, bit += width) {
+            uint32_t word = bit >> 5, shift = bit & 31;
+            __m128i v = _mm_srl_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * word)),
+                                      _mm_cvtsi32_si128(static_cast<int>(shift)));
+            if (shift + width > 32) {
+                __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * (word + 1)));
+                v = _mm_or_si128(v, _mm_sll_epi32(next, _mm_cvtsi32_si128(static_cast<int>(32 - shift))));
+            }
+            prev = _mm_add_epi32(prev, _mm_and_si128(v, mask));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * j), prev);
+        }
+#else
+        uint32_t prev[4] = {previous, previous, previous, previous};
+        uint32_t mask = lowMask(width);
+        for (uint32_t j = 0, bit = 0; j < BLOCK / 4; j++, bit += width) {
+            uint32_t word = bit >> 5, shift = bit & 31;
+            for (uint32_t lane = 0; lane < 4; lane++) {
+                uint32_t v = width == 0 ? 0 : in[4 * word + lane] >> shift;
+                if (width > 0 && shift + width > 32) v |= in[4 * (word + 1) + lane] << (32 - shift);
+                prev[lane] += v & mask;
+                out[4 * j + lane] = prev[lane];
+            }
+        }
+#endif
+    }
+
+    // Partial block: sequential deltas, scalar
+    static void decodeTailBlock(const uint32_t* in, uint32_t width, uint32_t previous, uint32_t count,
+                                uint32_t* out) {
+        uint32_t mask = lowMask(width);
+        uint32_t id = previous;
+        for (uint32_t j = 0, bit = 0; j < count; j++, bit += width) {
+            uint32_t v = 0;
+            if (width > 0) {
+                uint32_t word = bit >> 5, shift = bit & 31;
+                v = in[word] >> shift;
+                if (shift + width > 32) v |= in[word + 1] << (32 - shift);
+            }
+            id += v & mask;
+            out[j] = id;
+        }
+    }
+
+    // Half-star codes to ratings, two codes per byte (low nibble first)
+    static void decodeRatings(const uint8_t* in, uint32_t count, float* out) {
+        uint32_t j = 0;
+#if defined(__SSE2__)
+        const __m128i low = _mm_set1_epi8(0x0F);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (; j + 32 <= count; j += 32) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + j / 2));
+            __m128i lo = _mm_and_si128(bytes, low);
+            __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), low);
+            __m128i halves[2] = {_mm_unpacklo_epi8(lo, hi), _mm_unpackhi_epi8(lo, hi)};
+            for (int h = 0; h < 2; h++) {
+                __m128i words[2] = {_mm_unpacklo_epi8(halves[h], zero), _mm_unpackhi_epi8(halves[h], zero)};
+                for (int w = 0; w < 2; w++) {
+                    float* dst = out + j + h * 16 + w * 8;
+                    _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words[w], zero)), half));
+                    _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words[w], zero)), half));
+                }
+            }
+        }
+#endif
+        for (; j < count; j++) {
+            uint8_t code = (in[j / 2] >> ((j & 1) * 4)) & 0x0F;
+            out[j] = code * 0.5f;
+        }
+    }
+
+    // Decode block b of row into ids/values; returns the number of entries
+    uint32_t decodeBlock(int row, uint32_t b, uint32_t* ids, float* values) const {
+        uint32_t first = blockOffsets[row] + b;
+        uint32_t count = min(BLOCK, entryOffsets[row + 1] - entryOffsets[row] - b * BLOCK);
+        uint32_t previous = b == 0 ? 0 : blocks[first - 1].lastId;
+        const BlockInfo& info = blocks[first];
+        if (count == BLOCK) decodeFullBlock(packed.data() + info.dataOffset, info.width, previous, ids);
+        else decodeTailBlock(packed.data() + info.dataOffset, info.width, previous, count, ids);
+        decodeRatings(codes.data() + codeOffsets[row] + b * BLOCK / 2, count, values);
+        return count;
+    }
+
+public:
+    // Half-star code for a rating, or -1 if it does not fit in 4 bits
+    static int ratingCode(float rating) {
+        float doubled = rating * 2;
+        if (doubled < 0 || doubled > 15 || doubled != floor(doubled)) return -1;
+        return static_cast<int>(doubled);
+    }
+
+    // Compress a CSR matrix; false (and empty) if a rating is not a half star in [0, 7.5]
+    bool build(const RatingMatrix& matrix) {
+        *this = CompressedRatingMatrix();
+        for (float v : matrix.values) {
+            if (ratingCode(v) < 0) return false;
+        }
+
+        size_t rows = matrix.rows();
+        entryOffsets.assign(matrix.offsets.begin(), matrix.offsets.end());
+        blockOffsets.assign(rows + 1, 0);
+        codeOffsets.assign(rows + 1, 0);
+
+        uint32_t deltas[BLOCK];
+        for (size_t r = 0; r < rows; r++) {
+            blockOffsets[r] = static_cast<uint32_t>(blocks.size());
+            codeOffsets[r] = static_cast<uint32_t>(codes.size());
+            uint32_t begin = matrix.offsets[r], end = matrix.offsets[r + 1];
+            const int* ids = matrix.index.data();
+
+            for (uint32_t start = begin; start < end; start += BLOCK) {
+                uint32_t count = min(BLOCK, end - start);
+                uint32_t previous = start == begin ? 0 : static_cast<uint32_t>(ids[start - 1]);
+                bool full = count == BLOCK;
+                uint32_t widest = 0;
+                for (uint32_t i = 0; i < count; i++) {
+                    uint32_t back = full ? (i < 4 ? previous : ids[start + i - 4])
+                                         : (i == 0 ? previous : ids[start + i - 1]);
+                    deltas[i] = static_cast<uint32_t>(ids[start + i]) - back;
+                    widest |= deltas[i];
+                }
+                uint32_t width = bitWidth(widest);
+                blocks.push_back({static_cast<uint32_t>(ids[start + count - 1]),
+                                  static_cast<uint32_t>(packed.size()), width});
+                pack(deltas, count, width, full);
+            }
+
+            for (uint32_t j = begin; j < end; j += 2) {
+                uint8_t lo = static_cast<uint8_t>(ratingCode(matrix.values[j]));
+                uint8_t hi = j + 1 < end ? static_cast<uint8_t>(ratingCode(matrix.values[j + 1])) : 0;
+                codes.push_back(static_cast<uint8_t>(lo | (hi << 4)));
+            }
+        }
+        blockOffsets[rows] = static_cast<uint32_t>(blocks.size());
+        codeOffsets[rows] = static_cast<uint32_t>(codes.size());
+        // The SSE2 rating decode reads 16 bytes at a time
+        codes.resize(codes.size() + 16, 0);
+        return true;
+    }
+
+    bool empty() const { return entryOffsets.empty(); }
+    size_t rows() const { return entryOffsets.empty() ? 0 : entryOffsets.size() - 1; }
+    size_t nonZeros() const { return entryOffsets.empty() ? 0 : entryOffsets.back(); }
+
+    size_t sizeInBytes() const {
+        return (entryOffsets.size() + blockOffsets.size() + codeOffsets.size() + packed.size()) * sizeof(uint32_t)
+               + blocks.size() * sizeof(BlockInfo) + codes.size();
+    }
+
+    // f(col, value) for every rating in the row, columns ascending
+    template <typename F>
+    void forEachInRow(int row, F&& f) const {
+        uint32_t ids[BLOCK];
+        float values[BLOCK];
+        uint32_t numBlocks = blockOffsets[row + 1] - blockOffsets[row];
+        for (uint32_t b = 0; b < numBlocks; b++) {
+            uint32_t count = decodeBlock(row, b, ids, values);
+            for (uint32_t i = 0; i < count; i++) f(static_cast<int>(ids[i]), values[i]);
+        }
+    }
+
+    // The k-th rating of a row as (col, value)
+    pair<int, float> entryAt(int row, uint32_t k) const {
+        uint32_t ids[BLOCK];
+        float values[BLOCK];
+        decodeBlock(row, k / BLOCK, ids, values);
+        return {static_cast<int>(ids[k % BLOCK]), values[k % BLOCK]};
+    }
+};
+
+#endif //COMPRESSEDRATINGS_H
@@ -0,0 +1,183 @@
+#ifndef DATASETGENERATOR_H
+#define DATASETGENERATOR_H
+#include <string>
+#include <vector>
+#include <random>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_set>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+using namespace std;
+
+// Synthetic MovieLens-format data (movies.csv, ratings.csv, tags.csv,
+// links.csv) for load and query scaling tests. Movie popularity, user
+// activity and tag use follow Zipf distributions; the same config and seed
+// always produce byte-identical files.
+struct DatasetConfig {
+    int numMovies = 9742;        // defaults match the MovieLens "latest-small" release
+    int numUsers = 610;
+    size_t numRatings = 100836;
+    size_t numTags = 3683;
+    double popularitySkew = 1.0; // Zipf exponent over movies
+    double activitySkew = 0.8;   // Zipf exponent over users
+    uint32_t seed = 42;
+
+    // Users, ratings and tags grow linearly with scale; the catalog grows with its square root
+    static DatasetConfig scaled(double scale, uint32_t seed = 42) {
+        DatasetConfig config;
+        config.numMovies = max(100, static_cast<int>(config.numMovies * sqrt(scale)));
+        config.numUsers = max(10, static_cast<int>(config.numUsers * scale));
+        config.numRatings = max<size_t>(config.numUsers, static_cast<size_t>(config.numRatings * scale));
+        config.numTags = static_cast<size_t>(config.numTags * scale);
+        config.seed = seed;
+        return config;
+    }
+};
+
+// What generateDataset actually wrote
+struct DatasetStats {
+    size_t movies = 0;
+    size_t users = 0;
+    size_t ratings = 0;
+    size_t tags = 0;
+};
+
+// Draws ranks 0..n-1 with P(k) proportional to 1 / (k + 1)^s
+class ZipfSampler {
+private:
+    vector<double> cdf;
+
+public:
+    ZipfSampler(size_t n, double s) : cdf(n) {
+        double total = 0;
+        for (size_t k = 0; k < n; k++) {
+            total += 1.0 / pow(static_cast<double>(k + 1), s);
+            cdf[k] = total;
+        }
+        for (double& c : cdf) c /= total;
+    }
+
+    template <typename Gen>
+    size_t operator()(Gen& gen) const {
+        double u = uniform_real_distribution<double>(0.0, 1.0)(gen);
+        return min(static_cast<size_t>(lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin()), cdf.size() - 1);
+    }
+};
+
+// Write the four CSVs into dir (which must exist); false on an I/O error
+inline bool generateDataset(const DatasetConfig& config, const string& dir, DatasetStats* stats = nullptr) {
+    static const char* GENRES[] = {
+        "Drama", "Comedy", "Thriller", "Action", "Romance", "Adventure", "Crime", "Sci-Fi", "Horror",
+        "Fantasy", "Children", "Animation", "Mystery", "Documentary", "War", "Musical", "Western",
+        "IMAX", "Film-Noir"
+    };
+    static const char* TAG_WORDS[] = {
+        "atmospheric", "funny", "visually appealing", "dark comedy", "thought-provoking", "twist ending",
+        "based on a book", "classic", "sci-fi", "superhero", "quirky", "dystopia", "surreal", "violence",
+        "great soundtrack", "time travel", "heist", "space", "pixar", "mindfuck", "psychology",
+        "romance", "cult film", "stylized", "philosophical", "slow", "predictable", "overrated",
+        "true story", "animation"
+    };
+    constexpr size_t NUM_GENRES = sizeof(GENRES) / sizeof(GENRES[0]);
+    constexpr size_t NUM_TAG_WORDS = sizeof(TAG_WORDS) / sizeof(TAG_WORDS[0]);
+
+    mt19937_64 gen(config.seed);
+    normal_distribution<double> qualityDist(3.5, 0.5);
+    normal_distribution<double> biasDist(0.0, 0.4);
+    normal_distribution<double> noiseDist(0.0, 0.8);
+    DatasetStats written;
+
+    // Sparse, increasing movie ids like MovieLens; popularity rank is shuffled over them
+    vector<int> movieIds(config.numMovies);
+    vector<double> quality(config.numMovies);
+    int nextId = 1;
+    for (int i = 0; i < config.numMovies; i++) {
+        movieIds[i] = nextId;
+        nextId += 1 + static_cast<int>(gen() % 3);
+        quality[i] = qualityDist(gen);
+    }
+    vector<int> byPopularity(config.numMovies);
+    for (int i = 0; i < config.numMovies; i++) byPopularity[i] = i;
+    shuffle(byPopularity.begin(), byPopularity.end(), gen);
+
+    ofstream movies(dir + "/movies.csv");
+    ofstream links(dir + "/links.csv");
+    if (!movies || !links) return false;
+    movies << "movieId,title,genres\n";
+    links << "movieId,imdbId,tmdbId\n";
+    ZipfSampler genreSampler(NUM_GENRES, 1.0);
+    char buffer[64];
+    for (int i = 0; i < config.numMovies; i++) {
+        int year = 1920 + static_cast<int>(gen() % 104);
+        movies << movieIds[i] << ",Synthetic Movie " << movieIds[i] << " (" << year << "),";
+        size_t numGenres = gen() % 50 == 0 ? 0 : 1 + gen() % 3;
+        if (numGenres == 0) movies << "(no genres listed)";
+        size_t used = 0; // bitmask of genres already written
+        for (size_t g = 0; g < numGenres; g++) {
+            size_t genre = genreSampler(gen);
+            if (used & (size_t(1) << genre)) continue;
+            movies << (used ? "|" : "") << GENRES[genre];
+            used |= size_t(1) << genre;
+        }
+        movies << '\n';
+        snprintf(buffer, sizeof(buffer), "%07d", 100000 + movieIds[i] * 7);
+        links << movieIds[i] << ',' << buffer << ',' << 800000 + movieIds[i] << '\n';
+    }
+    written.movies = config.numMovies;
+
+    // Ratings per user: one each, the rest spread by Zipf activity. A user
+    // never rates more than half the catalog so distinct picks stay cheap.
+    vector<size_t> perUser(config.numUsers, 1);
+    ZipfSampler activity(config.numUsers, config.activitySkew);
+    for (size_t r = config.numUsers; r < config.numRatings; r++) perUser[activity(gen)]++;
+    shuffle(perUser.begin(), perUser.end(), gen); // most active users are not the lowest ids
+    size_t maxPerUser = max<size_t>(1, config.numMovies / 2);
+
+    ofstream ratings(dir + "/ratings.csv");
+    if (!ratings) return false;
+    ratings << "userId,movieId,rating,timestamp\n";
+    ZipfSampler popularity(config.numMovies, config.popularitySkew);
+    unordered_set<int> picked;
+    vector<int> userMovies;
+    for (int u = 0; u < config.numUsers; u++) {
+        double bias = biasDist(gen);
+        size_t count = min(perUser[u], maxPerUser);
+        picked.clear();
+        while (picked.size() < count) picked.insert(byPopularity[popularity(gen)]);
+        userMovies.assign(picked.begin(), picked.end());
+        sort(userMovies.begin(), userMovies.end());
+
+        long long timestamp = 946684800 + static_cast<long long>(gen() % 700000000);
+        for (int movie : userMovies) {
+            double value = round((quality[movie] + bias + noiseDist(gen)) * 2) / 2;
+            value = min(5.0, max(0.5, value));
+            snprintf(buffer, sizeof(buffer), "%.1f", value);
+            ratings << u + 1 << ',' << movieIds[movie] << ',' << buffer << ',' << timestamp << '\n';
+            timestamp += gen() % 600;
+        }
+        written.ratings += count;
+    }
+    written.users = config.numUsers;
+
+    ofstream tags(dir + "/tags.csv");
+    if (!tags) return false;
+    tags << "userId,movieId,tag,timestamp\n";
+    ZipfSampler tagSampler(NUM_TAG_WORDS, 1.2);
+    for (size_t t = 0; t < config.numTags; t++) {
+        int user = 1 + static_cast<int>(activity(gen));
+        int movie = movieIds[byPopularity[popularity(gen)]];
+        tags << user << ',' << movie << ',' << TAG_WORDS[tagSampler(gen)] << ','
+             << 1136073600 + static_cast<long long>(gen() % 500000000) << '\n';
+    }
+    written.tags = config.numTags;
+
+    if (stats) *stats = written;
+    return static_cast<bool>(movies) && static_cast<bool>(ratings) && static_cast<bool>(tags)
+           && static_cast<bool>(links);
+}
+
+#endif //DATASETGENERATOR_H
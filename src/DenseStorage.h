@@ -0,0 +1,147 @@
+#ifndef DENSESTORAGE_H
+#define DENSESTORAGE_H
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include "Parallel.h"
+
+using namespace std;
+
+// Maps sparse external ids (userId, movieId) to dense slots 0..N-1.
+// Ids below MAX_FLAT_ID resolve through a flat table; anything else falls
+// back to a hash map so a stray huge id cannot blow up memory.
+class DenseIdMap {
+private:
+    static constexpr int MAX_FLAT_ID = 1 << 24;
+
+    vector<int> slotById;               // external id -> slot, -1 if absent
+    unordered_map<int, int> overflow;   // ids outside the flat range
+    vector<int> idBySlot;               // slot -> external id
+
+public:
+    // Slot for id, or -1 if the id was never inserted
+    int slotOf(int id) const {
+        if (id >= 0 && id < MAX_FLAT_ID) {
+            return static_cast<size_t>(id) < slotById.size() ? slotById[id] : -1;
+        }
+        auto it = overflow.find(id);
+        return it == overflow.end() ? -1 : it->second;
+    }
+
+    int idOf(int slot) const { return idBySlot[slot]; }
+
+    // Slot for id, assigning the next free slot if it is new
+    int insert(int id) {
+        int slot = slotOf(id);
+        if (slot >= 0) return slot;
+
+        slot = static_cast<int>(idBySlot.size());
+        if (id >= 0 && id < MAX_FLAT_ID) {
+            if (static_cast<size_t>(id) >= slotById.size()) {
+                slotById.resize(max(static_cast<size_t>(id) + 1, slotById.size() * 2), -1);
+            }
+            slotById[id] = slot;
+        } else {
+            overflow[id] = slot;
+        }
+        idBySlot.push_back(id);
+        return slot;
+    }
+
+    size_t size() const { return idBySlot.size(); }
+};
+
+// Sparse rows in compressed sparse row form: row r holds
+// (index[j], value[j]) for j in [offsets[r], offsets[r + 1]), index ascending.
+struct RatingMatrix {
+    vector<uint32_t> offsets;
+    vector<int> index;
+    vector<float> values;
+
+    size_t rows() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t nonZeros() const { return index.size(); }
+    uint32_t rowSize(int row) const { return offsets[row + 1] - offsets[row]; }
+
+    // Counting-sort (row, col, value) triples into rows; a repeated (row, col)
+    // keeps the last value, matching map-overwrite semantics.
+    struct Entry {
+        int row;
+        int col;
+        float value;
+    };
+
+    void build(const vector<Entry>& entries, size_t numRows, bool transpose) {
+        offsets.assign(numRows + 1, 0);
+        for (const auto& e : entries) offsets[(transpose ? e.col : e.row) + 1]++;
+        for (size_t r = 0; r < numRows; r++) offsets[r + 1] += offsets[r];
+
+        vector<pair<int, float>> cells(entries.size());
+        vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (const auto& e : entries) {
+            int r = transpose ? e.col : e.row;
+            int c = transpose ? e.row : e.col;
+            cells[fill[r]++] = {c, e.value};
+        }
+
+        // Sort each row and collapse duplicates, compacting in place
+        index.clear();
+        values.clear();
+        index.reserve(cells.size());
+        values.reserve(cells.size());
+        uint32_t begin = 0;
+        for (size_t r = 0; r < numRows; r++) {
+            uint32_t end = offsets[r + 1];
+            stable_sort(cells.begin() + begin, cells.begin() + end,
+                        [](const auto& a, const auto& b) { return a.first < b.first; });
+            offsets[r] = static_cast<uint32_t>(index.size());
+            for (uint32_t j = begin; j < end; j++) {
+                if (j + 1 < end && cells[j + 1].first == cells[j].first) continue;
+                index.push_back(cells[j].first);
+                values.push_back(cells[j].second);
+            }
+            begin = end;
+        }
+        offsets[numRows] = static_cast<uint32_t>(index.size());
+    }
+};
+
+// Per-row rating statistics (count, sum, sum of squares, mean) in flat arrays
+struct RatingAggregates {
+    vector<uint32_t> count;
+    vector<double> sum;
+    vector<double> sumSquares;
+    vector<float> mean;
+
+    void assign(size_t rows) {
+        count.assign(rows, 0);
+        sum.assign(rows, 0);
+        sumSquares.assign(rows, 0);
+        mean.assign(rows, 0);
+    }
+
+    void setRow(size_t r, uint32_t n, double s, double sq) {
+        count[r] = n;
+        sum[r] = s;
+        sumSquares[r] = sq;
+        mean[r] = n > 0 ? static_cast<float>(s / n) : 0.0f;
+    }
+
+    // One pass over every row of the matrix, rows split across threads
+    void build(const RatingMatrix& matrix) {
+        assign(matrix.rows());
+        parallelFor(matrix.rows(), [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; r++) {
+                double s = 0, sq = 0;
+                for (uint32_t j = matrix.offsets[r]; j < matrix.offsets[r + 1]; j++) {
+                    double v = matrix.values[j];
+                    s += v;
+                    sq += v * v;
+                }
+                setRow(r, matrix.offsets[r + 1] - matrix.offsets[r], s, sq);
+            }
+        });
+    }
+};
+
+#endif //DENSESTORAGE_H
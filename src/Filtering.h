@@ -10,89 +10,853 @@
 #include <iomanip>
 #include <fstream>
 #include <random>
+#include <cmath>
 #include "RBTree.h"
+#include "DenseStorage.h"
+#include "BitmapIndex.h"
+#include "Recommendation.h"
+#include "Similarity.h"
+#include "TopK.h"
+#include "Parallel.h"
+#include "RatingStore.h"
+#include "Pipeline.h"
+#include "CompressedRatings.h"
+#include "TagIndex.h"
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
 using namespace std;
 
+// Wall-clock budget for a single anytime query
+struct Deadline {
+    chrono::high_resolution_clock::time_point start;
+    chrono::high_resolution_clock::time_point end;
+
+    explicit Deadline(chrono::microseconds budget)
+        : start(chrono::high_resolution_clock::now()), end(start + budget) {}
+
+    bool expired() const { return chrono::high_resolution_clock::now() >= end; }
+
+    // When the first `share` of the budget runs out, for stages that must leave time to later ones
+    chrono::high_resolution_clock::time_point stageEnd(double share) const {
+        return start + chrono::duration_cast<chrono::high_resolution_clock::duration>((end - start) * share);
+    }
+};
+
+// Best-so-far recommendations from a deadline-bounded query
+struct AnytimeRecommendations {
+    vector<Recommendation> recommendations;
+    bool exact = true; // false if the deadline cut the computation short
+};
+
+// Blend of the hybrid recommender; each signal is scaled to [0, 1] before weighting
+struct HybridWeights {
+    float collaborative = 0.6f; // neighbours' weighted rating
+    float content = 0.3f;       // tag/genre cosine similarity
+    float popularity = 0.1f;    // Bayesian-average prior
+};
+
+// Time each ratings load stage spent working, excluding waits on its queues
+struct LoadTimings {
+    double readMs = 0;
+    double parseMs = 0;    // summed over parser threads
+    double shardMs = 0;    // summed over shard builders
+    double finalizeMs = 0; // user slots, CSR merge, aggregates and indexes
+    double totalMs = 0;    // wall clock for the whole ratings load
+    size_t parsers = 0;
+    size_t shards = 0;
+    size_t bytes = 0;
+};
+
 class CollaborativeFiltering {
 private:
     MovieRBTree movieTree;
-    unordered_map<int, User> users;
 
-    // Find users with similar taste (based on Pearson correlation)
-    vector<pair<int, float>> findSimilarUsers(int movieId, int k) {
-        auto node = movieTree.search(movieId);
-        if (node == nullptr || node == movieTree.getNIL()) {
-            return {};
+    // Sparse external ids are remapped to dense slots at load time; everything
+    // below works on slots and translates back only at the public API.
+    DenseIdMap userSlots;
+    DenseIdMap movieSlots;
+    vector<MovieNode*> movieNodes; // movie slot -> tree node
+
+    RatingMatrix userRatings;  // user slot -> (movie slot, rating)
+    RatingMatrix movieRatings; // movie slot -> (user slot, rating)
+
+    // Half-star rating sets replace the two matrices above with compressed rows
+    CompressedRatingMatrix userPacked;
+    CompressedRatingMatrix moviePacked;
+
+    // Out-of-core mode: the same rows served from disk through a block cache
+    // instead of the two matrices above (enabled with a non-zero budget)
+    size_t storeBudget = 0;
+    LoadTimings loadTimings;
+
+    // Sharded serving: this instance only loads users with userId % shardCount == shardIndex
+    int shardIndex = 0;
+    int shardCount = 1;
+    RatingStore userStore;
+    RatingStore movieStore;
+
+    MovieFilterIndex filterIndex; // genre / year / rating-count bitmaps over movie slots
+
+    RatingAggregates userStats;  // per user slot: count, sum, sum of squares, mean
+    RatingAggregates movieStats; // per movie slot
+    float globalMean = 0;
+    vector<float> bayesianScore; // movie slot -> Bayesian-average rating
+    vector<int> popularityOrder; // rated movie slots, most popular first
+
+    // Per-movie accumulator reused across queries; only touched slots are reset.
+    // Callers always add a positive `second`, which doubles as the touched flag.
+    struct MovieAccumulator {
+        vector<float> first, second;
+        vector<int> touched;
+
+        void resize(size_t n) {
+            first.assign(n, 0);
+            second.assign(n, 0);
+            touched.clear();
         }
 
-        vector<pair<int, float>> similarities;
-        const auto& targetRatings = node->movie.userRatings;
+        void add(int slot, float a, float b) {
+            if (second[slot] == 0) touched.push_back(slot);
+            first[slot] += a;
+            second[slot] += b;
+        }
+
+        void clear() {
+            for (int slot : touched) first[slot] = second[slot] = 0;
+            touched.clear();
+        }
+
+        // Reduction step: fold another buffer in and leave it empty
+        void mergeFrom(MovieAccumulator& other) {
+            for (int slot : other.touched) add(slot, other.first[slot], other.second[slot]);
+            other.clear();
+        }
+    };
+
+    // Working memory of one query. Every query leases a set from scratchPool
+    // for its duration, so concurrent queries on one instance never share
+    // buffers; sets go back to the pool afterwards, so steady-state queries
+    // do not allocate.
+    struct QueryScratch {
+        size_t rows = 0;
+        MovieAccumulator profile;        // audience profile sums
+        MovieAccumulator scores;         // (weighted sum, similarity sum) per movie
+        vector<MovieAccumulator> chunks; // one per extra pool thread
+
+        void resize(size_t n) {
+            rows = n;
+            profile.resize(n);
+            scores.resize(n);
+            chunks.resize(ThreadPool::concurrency() - 1);
+            for (auto& chunk : chunks) chunk.resize(n);
+        }
+    };
+
+    mutex scratchMutex;
+    vector<unique_ptr<QueryScratch>> scratchPool;
 
-        // Calculate similarity for each user who rated this movie
-        for (const auto& [userId, rating] : targetRatings) {
-            if (users.find(userId) == users.end()) continue;
+    class ScratchLease {
+    private:
+        CollaborativeFiltering& owner;
+        unique_ptr<QueryScratch> scratch;
 
-            const User& user = users[userId];
-            float similarity = calculatePearsonCorrelation(user.movieRatings, targetRatings);
-            similarities.push_back({userId, similarity});
+    public:
+        explicit ScratchLease(CollaborativeFiltering& cf) : owner(cf) {
+            {
+                lock_guard<mutex> lock(owner.scratchMutex);
+                if (!owner.scratchPool.empty()) {
+                    scratch = std::move(owner.scratchPool.back());
+                    owner.scratchPool.pop_back();
+                }
+            }
+            if (!scratch) scratch = make_unique<QueryScratch>();
+            if (scratch->rows != owner.movieSlots.size()) scratch->resize(owner.movieSlots.size());
         }
 
-        // Sort by similarity (descending)
-        sort(similarities.begin(), similarities.end(),
-             [](const auto& a, const auto& b) { return a.second > b.second; });
+        ~ScratchLease() {
+            lock_guard<mutex> lock(owner.scratchMutex);
+            owner.scratchPool.push_back(std::move(scratch));
+        }
+
+        ScratchLease(const ScratchLease&) = delete;
+        ScratchLease& operator=(const ScratchLease&) = delete;
+
+        QueryScratch& operator*() const { return *scratch; }
+        QueryScratch* operator->() const { return scratch.get(); }
+    };
 
-        // Return top k similar users
-        if (static_cast<size_t>(k) < similarities.size()) {
-            similarities.resize(k);
+    // Queries touching fewer ratings than this stay on the serial path
+    static constexpr size_t PARALLEL_MIN_RATINGS = 200000;
+
+    // Accumulate users[0..n) into `target`, splitting the list across per-chunk
+    // buffers when `work` (ratings visited) is large, then reduce.
+    // visit(i, add) calls add(movieSlot, a, b) for each contribution of users[i].
+    template <typename Visit>
+    void accumulateUsers(QueryScratch& scratch, size_t n, size_t work, MovieAccumulator& target, Visit&& visit) {
+        vector<MovieAccumulator>& buffers = scratch.chunks;
+        size_t chunks = work >= PARALLEL_MIN_RATINGS ? min(ThreadPool::concurrency(), buffers.size() + 1) : 1;
+        chunks = min(chunks, max<size_t>(n, 1));
+        parallelChunks(n, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            MovieAccumulator& local = chunk == 0 ? target : buffers[chunk - 1];
+            for (size_t i = begin; i < end; i++) {
+                visit(i, [&](int slot, float a, float b) { local.add(slot, a, b); });
+            }
+        });
+        for (size_t c = 0; c + 1 < chunks && c < buffers.size(); c++) {
+            target.mergeFrom(buffers[c]);
         }
+    }
+
+    // Ratings visited between clock reads in anytime mode. Raters are visited
+    // most-active first, so the interval counts ratings rather than raters.
+    static constexpr size_t DEADLINE_CHECK_RATINGS = 2048;
+
+    // Share of an anytime budget by which the profile and rater scoring stages
+    // stop; neighbour accumulation gets the rest
+    static constexpr double PROFILE_BUDGET_SHARE = 0.3;
+    static constexpr double SCORING_BUDGET_SHARE = 0.6;
 
+    // Reads the clock against one stage of a deadline once the ratings visited
+    // since the last read, plus the row about to be visited, reach
+    // DEADLINE_CHECK_RATINGS; a row that long on its own is always preceded by a read
+    struct DeadlineMeter {
+        bool active;
+        chrono::high_resolution_clock::time_point end;
+        size_t unchecked = 0;
+
+        DeadlineMeter(const Deadline* deadline, double share)
+            : active(deadline != nullptr) {
+            if (deadline) end = deadline->stageEnd(share);
+        }
+
+        // Call before visiting a row of `ratings` ratings; true if the stage is over
+        bool expiredBefore(size_t ratings) {
+            if (!active) return false;
+            if (unchecked + ratings >= DEADLINE_CHECK_RATINGS) {
+                if (chrono::high_resolution_clock::now() >= end) return true;
+                unchecked = 0;
+            }
+            unchecked += ratings;
+            return false;
+        }
+    };
+
+    SimilarityMetric metric = SimilarityMetric::PEARSON;
+
+    template <typename F>
+    void forEachUserRating(int userSlot, F&& f) const {
+        if (userStore.isOpen()) {
+            userStore.forEachInRow(userSlot, f);
+            return;
+        }
+        if (!userPacked.empty()) {
+            userPacked.forEachInRow(userSlot, f);
+            return;
+        }
+        for (uint32_t j = userRatings.offsets[userSlot]; j < userRatings.offsets[userSlot + 1]; j++) {
+            f(userRatings.index[j], userRatings.values[j]);
+        }
+    }
+
+    template <typename F>
+    void forEachMovieRating(int movieSlot, F&& f) const {
+        if (movieStore.isOpen()) {
+            movieStore.forEachInRow(movieSlot, f);
+            return;
+        }
+        if (!moviePacked.empty()) {
+            moviePacked.forEachInRow(movieSlot, f);
+            return;
+        }
+        for (uint32_t j = movieRatings.offsets[movieSlot]; j < movieRatings.offsets[movieSlot + 1]; j++) {
+            f(movieRatings.index[j], movieRatings.values[j]);
+        }
+    }
+
+    // Call f(Similarity(), Overlap()) with the policy pair of a metric
+    template <typename F>
+    static auto withMetricPolicies(SimilarityMetric similarityMetric, F&& f) {
+        switch (similarityMetric) {
+            case SimilarityMetric::SHRUNK_PEARSON:
+                return f(PearsonSimilarity(), ShrunkOverlap<5, 25>());
+            case SimilarityMetric::COSINE:
+                return f(CosineSimilarity(), MinimumOverlap<5>());
+            case SimilarityMetric::ADJUSTED_COSINE:
+                return f(AdjustedCosineSimilarity(), MinimumOverlap<5>());
+            case SimilarityMetric::JACCARD:
+                return f(JaccardSimilarity(), MinimumOverlap<5>());
+            case SimilarityMetric::PEARSON:
+            default:
+                return f(PearsonSimilarity(), MinimumOverlap<5>());
+        }
+    }
+
+    // Find users with similar taste under the given metric. The switch
+    // picks a policy instantiation once per query; the scan itself is static.
+    vector<pair<int, float>> findSimilarUsers(QueryScratch& scratch, int movieSlot, int k,
+                                              SimilarityMetric similarityMetric,
+                                              const Deadline* deadline = nullptr,
+                                              bool* exact = nullptr) {
+        vector<pair<float, int>> best = rankSimilarUsers(scratch, movieSlot, k, similarityMetric, deadline, exact);
+        sort(best.begin(), best.end(), greater<>());
+
+        // Top k similar users, most similar first
+        vector<pair<int, float>> similarities;
+        for (const auto& [similarity, userSlot] : best) {
+            similarities.push_back({userSlot, similarity});
+        }
         return similarities;
     }
 
-    // Calculate Pearson correlation between two users' ratings
-    float calculatePearsonCorrelation(const unordered_map<int, float>& ratings1,
-                                     const unordered_map<int, float>& ratings2) {
-        vector<float> r1, r2;
+    // The k most similar raters as unordered (similarity, user slot) pairs, for
+    // callers that only need to sort a prefix of them
+    vector<pair<float, int>> rankSimilarUsers(QueryScratch& scratch, int movieSlot, int k,
+                                              SimilarityMetric similarityMetric,
+                                              const Deadline* deadline, bool* exact) {
+        return withMetricPolicies(similarityMetric, [&](auto similarity, auto overlap) {
+            return findSimilarUsersWith<decltype(similarity), decltype(overlap)>(scratch, movieSlot, k, deadline,
+                                                                                 exact);
+        });
+    }
+
+    // Each rater of the movie is compared against the movie's audience profile:
+    // the mean rating every other movie received from this movie's raters.
+    // With a deadline, raters are processed most-active first and each stage
+    // stops once its share of the budget passes; `exact` is cleared if any
+    // rater was skipped. Leave-one-out evaluation passes the held-out user as
+    // excludedUser and item means without the held-out rating.
+    template <typename Similarity, typename Overlap>
+    vector<pair<float, int>> findSimilarUsersWith(QueryScratch& scratch, int movieSlot, int k,
+                                                  const Deadline* deadline, bool* exact,
+                                                  int excludedUser = -1, const float* itemMean = nullptr) {
+        vector<pair<int, float>> raters; // (user slot, rating of this movie)
+        raters.reserve(movieStats.count[movieSlot]);
+        forEachMovieRating(movieSlot, [&](int userSlot, float rating) {
+            if (userSlot != excludedUser) raters.push_back({userSlot, rating});
+        });
+
+        // Build the audience profile from as many raters as the deadline allows.
+        // Without a deadline the rater loop is split across the pool for big movies.
+        MovieAccumulator& profile = scratch.profile;
+        size_t profiled = 0;
+        size_t work = 0;
+        for (const auto& rater : raters) work += userStats.count[rater.first];
+        bool parallel = !deadline && work >= PARALLEL_MIN_RATINGS && ThreadPool::concurrency() > 1;
 
-        // Find movies rated by both users
-        for (const auto& [movieId, rating1] : ratings1) {
-            auto it = ratings2.find(movieId);
-            if (it != ratings2.end()) {
-                r1.push_back(rating1);
-                r2.push_back(it->second);
+        if (parallel) {
+            accumulateUsers(scratch, raters.size(), work, profile, [&](size_t i, auto&& add) {
+                forEachUserRating(raters[i].first, [&](int ratedSlot, float ratedValue) {
+                    if (ratedSlot != movieSlot) add(ratedSlot, ratedValue, 1.0f);
+                });
+            });
+            profiled = raters.size();
+        } else {
+            // With a deadline, raters go most-active first so an early stop keeps
+            // the most informative ones. They are ordered in growing blocks, as
+            // far as the deadline lets the loop get, not sorted up front.
+            DeadlineMeter meter(deadline, PROFILE_BUDGET_SHARE);
+            size_t orderedEnd = 0;
+            for (; profiled < raters.size(); profiled++) {
+                if (deadline && profiled == orderedEnd) {
+                    orderedEnd = min(raters.size(), max<size_t>(32, orderedEnd * 4));
+                    partial_sort(raters.begin() + profiled, raters.begin() + orderedEnd, raters.end(),
+                                 [&](const auto& a, const auto& b) {
+                                     return userStats.count[a.first] > userStats.count[b.first];
+                                 });
+                }
+                int userSlot = raters[profiled].first;
+                if (meter.expiredBefore(userStats.count[userSlot]) && profiled > 0) {
+                    if (exact) *exact = false;
+                    break;
+                }
+                forEachUserRating(userSlot, [&](int ratedSlot, float ratedValue) {
+                    if (ratedSlot != movieSlot) profile.add(ratedSlot, ratedValue, 1.0f);
+                });
             }
         }
 
-        int n = r1.size();
-        if (n < 5) { // Need at least 5 common ratings for meaningful correlation
+        // Turn profile sums into means once, so the per-rater loop never divides
+        size_t profileLiked = 0;
+        for (int slot : profile.touched) {
+            profile.first[slot] /= profile.second[slot];
+            profileLiked += profile.first[slot] >= LIKE_THRESHOLD;
+        }
+
+        TopK best = scoreRaters<Similarity, Overlap>(movieSlot, raters, profiled, profile.first, profileLiked,
+                                                      itemMean ? itemMean : movieStats.mean.data(), k, parallel,
+                                                      deadline, exact);
+        profile.clear();
+        return best.release();
+    }
+
+    // Score raters[0..count) against profile means into per-chunk top-k heaps
+    // and merge them; heap ids are user slots
+    template <typename Similarity, typename Overlap>
+    TopK scoreRaters(int movieSlot, const vector<pair<int, float>>& raters, size_t count,
+                     const vector<float>& profileMean, size_t profileLiked, const float* itemMean, int k,
+                     bool parallel, const Deadline* deadline, bool* exact) const {
+        size_t limit = static_cast<size_t>(max(k, 0));
+        size_t chunks = parallel ? ThreadPool::concurrency() : 1;
+        vector<TopK> partial(chunks, TopK(limit, count));
+        parallelChunks(count, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            DeadlineMeter meter(deadline, SCORING_BUDGET_SHARE);
+            for (size_t i = begin; i < end; i++) {
+                const auto& [userSlot, rating] = raters[i];
+                if (meter.expiredBefore(userStats.count[userSlot]) && i > begin) {
+                    if (exact) *exact = false;
+                    break;
+                }
+                float similarity = scoreRater<Similarity, Overlap>(userSlot, movieSlot, rating, profileMean,
+                                                                   profileLiked, itemMean);
+                partial[chunk].push(similarity, userSlot);
+            }
+        });
+        for (size_t c = 1; c < partial.size(); c++) partial[0].merge(partial[c]);
+        return std::move(partial[0]);
+    }
+
+    // Similarity of one rater to the audience profile. The rater's side (count,
+    // sum, sum of squares) comes from the precomputed aggregates minus the
+    // target movie, so the loop only touches the profile side.
+    template <typename Similarity, typename Overlap>
+    float scoreRater(int userSlot, int excludedMovieSlot, float excludedRating,
+                     const vector<float>& profileMean, size_t profileLiked, const float* itemMean) const {
+        int n = static_cast<int>(userStats.count[userSlot]) - 1;
+        if (!Overlap::accept(n)) {
             return 0.0f;
         }
 
-        // Calculate means
-        float sum1 = 0, sum2 = 0;
-        for (int i = 0; i < n; i++) {
-            sum1 += r1[i];
-            sum2 += r2[i];
+        SimilarityInput input{n,
+                              userStats.sum[userSlot] - excludedRating,
+                              userStats.sumSquares[userSlot] - static_cast<double>(excludedRating) * excludedRating,
+                              userStats.mean[userSlot],
+                              profileLiked};
+        typename Similarity::State state = Similarity::start(input);
+
+        forEachUserRating(userSlot, [&](int ratedSlot, float rating) {
+            if (ratedSlot == excludedMovieSlot) return;
+            Similarity::accumulate(state, rating, profileMean[ratedSlot], itemMean[ratedSlot]);
+        });
+
+        return Overlap::shrink(Similarity::finish(state, input), n);
+    }
+
+    // The k-th rating of a movie row as (user slot, rating)
+    pair<int, float> movieRatingAt(int movieSlot, uint32_t k) const {
+        if (movieStore.isOpen()) return movieStore.entryAt(movieSlot, k);
+        if (!moviePacked.empty()) return moviePacked.entryAt(movieSlot, k);
+        uint32_t pos = movieRatings.offsets[movieSlot] + k;
+        return {movieRatings.index[pos], movieRatings.values[pos]};
+    }
+
+    // Call f(userId, movieId, rating) for every well-formed line of ratings.csv
+    template <typename F>
+    bool scanRatings(const string& ratingsFile, F&& f) {
+        ifstream ratingStream(ratingsFile);
+        if (!ratingStream.is_open()) {
+            cerr << "Error opening ratings file: " << ratingsFile << endl;
+            return false;
+        }
+
+        string line;
+        // Skip header
+        getline(ratingStream, line);
+
+        while (getline(ratingStream, line)) {
+            int userId, movieId;
+            float rating;
+            if (parseRatingLine(line.data(), line.data() + line.size(), userId, movieId, rating)) {
+                f(userId, movieId, rating);
+            }
+        }
+        return true;
+    }
+
+    // Parse "userId,movieId,rating[,timestamp]" in [begin, end); false if malformed
+    static bool parseRatingLine(const char* begin, const char* end, int& userId, int& movieId, float& rating) {
+        char* next;
+        long user = strtol(begin, &next, 10);
+        if (next == begin || next >= end || *next != ',') return false;
+        const char* field = next + 1;
+        long movie = strtol(field, &next, 10);
+        if (next == field || next >= end || *next != ',') return false;
+        field = next + 1;
+        float value = strtof(field, &next);
+        if (next == field || next > end) return false;
+        userId = static_cast<int>(user);
+        movieId = static_cast<int>(movie);
+        rating = value;
+        return true;
+    }
+
+    static constexpr size_t READ_CHUNK_BYTES = 1 << 20;
+
+    // In-memory ratings load as a staged pipeline over bounded blocking queues:
+    //   reader (chunks cut at line ends) -> parsers -> shard builders -> finalizer
+    // Parsers route each chunk's ratings to shard userId % shards. Once its
+    // input closes, a shard builds sorted, de-duplicated CSR rows for its own
+    // users and counts their ratings per movie. The finalizer assigns user
+    // slots by each user's earliest position in the file, as a serial scan
+    // does, and only merges: user rows are copied in slot order and movie
+    // rows are filled by walking them, which leaves each movie sorted by user.
+    bool loadRatingsPipelined(const string& ratingsFile) {
+        ifstream ratingStream(ratingsFile, ios::binary);
+        if (!ratingStream.is_open()) {
+            cerr << "Error opening ratings file: " << ratingsFile << endl;
+            return false;
+        }
+        using Clock = chrono::steady_clock;
+        auto elapsedMs = [](Clock::time_point since) {
+            return chrono::duration<double, milli>(Clock::now() - since).count();
+        };
+
+        size_t threads = ThreadPool::concurrency();
+        size_t numParsers = max<size_t>(1, threads / 2);
+        size_t numShards = max<size_t>(1, threads / 4);
+        loadTimings = LoadTimings();
+        loadTimings.parsers = numParsers;
+        loadTimings.shards = numShards;
+
+        struct Chunk {
+            uint32_t seq;
+            string text;
+        };
+        struct RawRating {
+            int userId;
+            int movieSlot;
+            float rating;
+            uint32_t line; // line within the chunk
+        };
+        struct Batch {
+            uint32_t seq;
+            vector<RawRating> ratings;
+        };
+        struct Shard {
+            vector<Batch> batches;
+            unordered_map<int, uint32_t> rowOf; // userId -> shard row
+            vector<int> userIds;                // shard row -> userId
+            vector<uint64_t> firstSeen;         // shard row -> (chunk seq << 32 | line)
+            RatingMatrix rows;                  // shard row -> (movie slot, rating)
+            vector<uint32_t> movieCounts;       // movie slot -> ratings in rows
+            double busyMs = 0;
+        };
+
+        vector<unique_ptr<BoundedQueue<Chunk>>> chunkQueues; // reader -> parser p
+        vector<unique_ptr<BoundedQueue<Batch>>> batchQueues; // every parser -> shard s
+        for (size_t p = 0; p < numParsers; p++) chunkQueues.push_back(make_unique<BoundedQueue<Chunk>>(8));
+        for (size_t s = 0; s < numShards; s++) {
+            batchQueues.push_back(make_unique<BoundedQueue<Batch>>(16 * numParsers, numParsers));
+        }
+        vector<Shard> shards(numShards);
+        vector<double> parseMs(numParsers, 0);
+
+        thread reader([&] {
+            vector<char> buffer(READ_CHUNK_BYTES);
+            string carry;
+            uint32_t seq = 0;
+            bool skipHeader = true;
+            auto emit = [&](string text) {
+                if (skipHeader) {
+                    size_t eol = text.find('\n');
+                    text.erase(0, eol == string::npos ? text.size() : eol + 1);
+                    skipHeader = false;
+                }
+                if (text.empty()) return;
+                chunkQueues[seq % numParsers]->push({seq, std::move(text)});
+                seq++;
+            };
+
+            while (true) {
+                auto started = Clock::now();
+                ratingStream.read(buffer.data(), buffer.size());
+                size_t got = static_cast<size_t>(ratingStream.gcount());
+                if (got == 0) break;
+                loadTimings.bytes += got;
+
+                // Whole lines go downstream; the partial last line waits for the next read
+                string text = std::move(carry);
+                text.append(buffer.data(), got);
+                size_t cut = text.rfind('\n');
+                if (cut == string::npos) {
+                    carry = std::move(text);
+                    loadTimings.readMs += elapsedMs(started);
+                    continue;
+                }
+                carry.assign(text, cut + 1, string::npos);
+                text.resize(cut + 1);
+                loadTimings.readMs += elapsedMs(started);
+                emit(std::move(text));
+            }
+            if (!carry.empty()) emit(std::move(carry));
+            for (auto& queue : chunkQueues) queue->close();
+        });
+
+        vector<thread> parsers;
+        for (size_t p = 0; p < numParsers; p++) {
+            parsers.emplace_back([&, p] {
+                Chunk chunk;
+                while (chunkQueues[p]->pop(chunk)) {
+                    auto started = Clock::now();
+                    vector<Batch> out(numShards);
+                    for (auto& batch : out) batch.seq = chunk.seq;
+
+                    const char* pos = chunk.text.data();
+                    const char* end = pos + chunk.text.size();
+                    for (uint32_t line = 0; pos < end; line++) {
+                        const char* eol = static_cast<const char*>(memchr(pos, '\n', end - pos));
+                        if (!eol) eol = end;
+                        int userId, movieId;
+                        float rating;
+                        if (parseRatingLine(pos, eol, userId, movieId, rating) && ownsUser(userId)) {
+                            // Ratings for movies missing from movies.csv can never be shown
+                            int movieSlot = movieSlots.slotOf(movieId);
+                            if (movieSlot >= 0) {
+                                out[static_cast<unsigned>(userId) % numShards].ratings.push_back(
+                                        {userId, movieSlot, rating, line});
+                            }
+                        }
+                        pos = eol + 1;
+                    }
+                    parseMs[p] += elapsedMs(started);
+
+                    for (size_t s = 0; s < numShards; s++) batchQueues[s]->push(std::move(out[s]));
+                }
+                for (size_t s = 0; s < numShards; s++) batchQueues[s]->close();
+            });
+        }
+
+        vector<thread> builders;
+        for (size_t s = 0; s < numShards; s++) {
+            builders.emplace_back([&, s] {
+                Shard& shard = shards[s];
+                Batch batch;
+                while (batchQueues[s]->pop(batch)) {
+                    auto started = Clock::now();
+                    int previousUser = 0;
+                    for (size_t i = 0; i < batch.ratings.size(); i++) {
+                        // Files are usually grouped by user; only a run's first line matters
+                        const RawRating& r = batch.ratings[i];
+                        if (i > 0 && r.userId == previousUser) continue;
+                        previousUser = r.userId;
+                        uint64_t at = (static_cast<uint64_t>(batch.seq) << 32) | r.line;
+                        auto [it, inserted] = shard.rowOf.emplace(r.userId, static_cast<uint32_t>(shard.userIds.size()));
+                        if (inserted) {
+                            shard.userIds.push_back(r.userId);
+                            shard.firstSeen.push_back(at);
+                        } else if (at < shard.firstSeen[it->second]) {
+                            shard.firstSeen[it->second] = at;
+                        }
+                    }
+                    shard.batches.push_back(std::move(batch));
+                    shard.busyMs += elapsedMs(started);
+                }
+
+                // Replaying the batches in chunk order keeps each user's ratings
+                // in file order, so a repeated movie keeps its last rating
+                auto started = Clock::now();
+                sort(shard.batches.begin(), shard.batches.end(),
+                     [](const Batch& a, const Batch& b) { return a.seq < b.seq; });
+                vector<RatingMatrix::Entry> entries;
+                for (Batch& batch : shard.batches) {
+                    int previousUser = 0;
+                    uint32_t row = 0;
+                    for (size_t i = 0; i < batch.ratings.size(); i++) {
+                        const RawRating& r = batch.ratings[i];
+                        if (i == 0 || r.userId != previousUser) row = shard.rowOf[r.userId];
+                        previousUser = r.userId;
+                        entries.push_back({static_cast<int>(row), r.movieSlot, r.rating});
+                    }
+                    vector<RawRating>().swap(batch.ratings);
+                }
+                vector<Batch>().swap(shard.batches);
+                unordered_map<int, uint32_t>().swap(shard.rowOf);
+                shard.rows.build(entries, shard.userIds.size(), false);
+                shard.movieCounts.assign(movieSlots.size(), 0);
+                for (int movieSlot : shard.rows.index) shard.movieCounts[movieSlot]++;
+                shard.busyMs += elapsedMs(started);
+            });
+        }
+
+        reader.join();
+        for (auto& t : parsers) t.join();
+        for (auto& t : builders) t.join();
+        for (double ms : parseMs) loadTimings.parseMs += ms;
+        for (const Shard& shard : shards) loadTimings.shardMs += shard.busyMs;
+
+        auto finalizeStart = Clock::now();
+
+        // User slots in order of first appearance, as a serial scan assigns them
+        struct FirstSeen {
+            uint64_t at;
+            uint32_t shard;
+            uint32_t row;
+        };
+        vector<FirstSeen> firstSeen;
+        for (size_t sh = 0; sh < shards.size(); sh++) {
+            for (uint32_t row = 0; row < shards[sh].firstSeen.size(); row++) {
+                firstSeen.push_back({shards[sh].firstSeen[row], static_cast<uint32_t>(sh), row});
+            }
+        }
+        sort(firstSeen.begin(), firstSeen.end(), [](const FirstSeen& a, const FirstSeen& b) { return a.at < b.at; });
+        for (const FirstSeen& f : firstSeen) userSlots.insert(shards[f.shard].userIds[f.row]);
+
+        // Both orientations at once. Every row offset is known up front from
+        // the shards' row sizes and movie counts.
+        size_t nonZeros = 0;
+        for (const Shard& shard : shards) nonZeros += shard.rows.nonZeros();
+        parallelChunks(2, 2, [&](size_t chunk, size_t, size_t) {
+            RatingMatrix& out = chunk == 0 ? userRatings : movieRatings;
+            out.index.resize(nonZeros);
+            out.values.resize(nonZeros);
+            if (chunk == 0) {
+                out.offsets.assign(firstSeen.size() + 1, 0);
+                for (size_t slot = 0; slot < firstSeen.size(); slot++) {
+                    const RatingMatrix& rows = shards[firstSeen[slot].shard].rows;
+                    uint32_t begin = rows.offsets[firstSeen[slot].row], end = rows.offsets[firstSeen[slot].row + 1];
+                    copy(rows.index.begin() + begin, rows.index.begin() + end, out.index.begin() + out.offsets[slot]);
+                    copy(rows.values.begin() + begin, rows.values.begin() + end, out.values.begin() + out.offsets[slot]);
+                    out.offsets[slot + 1] = out.offsets[slot] + (end - begin);
+                }
+                return;
+            }
+            out.offsets.assign(movieSlots.size() + 1, 0);
+            for (const Shard& shard : shards) {
+                for (size_t m = 0; m < movieSlots.size(); m++) out.offsets[m + 1] += shard.movieCounts[m];
+            }
+            for (size_t m = 0; m < movieSlots.size(); m++) out.offsets[m + 1] += out.offsets[m];
+            vector<uint32_t> fill(out.offsets.begin(), out.offsets.end() - 1);
+            for (size_t slot = 0; slot < firstSeen.size(); slot++) {
+                const RatingMatrix& rows = shards[firstSeen[slot].shard].rows;
+                for (uint32_t j = rows.offsets[firstSeen[slot].row]; j < rows.offsets[firstSeen[slot].row + 1]; j++) {
+                    uint32_t pos = fill[rows.index[j]]++;
+                    out.index[pos] = static_cast<int>(slot);
+                    out.values[pos] = rows.values[j];
+                }
+            }
+        });
+        vector<Shard>().swap(shards);
+
+        // Per-user and per-movie aggregates feed similarity, popularity and cold start
+        userStats.build(userRatings);
+        movieStats.build(movieRatings);
+        loadTimings.finalizeMs += elapsedMs(finalizeStart);
+        return true;
+    }
+
+    // Stream ratings.csv twice into on-disk user- and movie-major stores:
+    // pass 1 sizes every row, pass 2 scatters ratings into place. Only per-row
+    // counters and the id maps are held in memory.
+    bool loadRatingsOutOfCore(const string& ratingsFile) {
+        vector<uint64_t> userCounts, movieCounts(movieSlots.size(), 0);
+        bool ok = scanRatings(ratingsFile, [&](int userId, int movieId, float) {
+            int movieSlot = movieSlots.slotOf(movieId);
+            if (movieSlot < 0 || !ownsUser(userId)) return;
+            size_t userSlot = userSlots.insert(userId);
+            if (userSlot >= userCounts.size()) userCounts.resize(userSlot + 1, 0);
+            userCounts[userSlot]++;
+            movieCounts[movieSlot]++;
+        });
+        if (!ok) return false;
+
+        string userPath = ratingsFile + ".users.store";
+        string moviePath = ratingsFile + ".movies.store";
+        RatingStoreWriter userWriter, movieWriter;
+        // Writers buffer within the same budget the stores will cache in
+        if (!userWriter.create(userPath, userCounts, storeBudget / 2)
+            || !movieWriter.create(moviePath, movieCounts, storeBudget / 2)) {
+            cerr << "Error creating rating store next to " << ratingsFile << endl;
+            return false;
+        }
+        userCounts.clear();
+        userCounts.shrink_to_fit();
+        movieCounts.clear();
+        movieCounts.shrink_to_fit();
+
+        scanRatings(ratingsFile, [&](int userId, int movieId, float rating) {
+            int movieSlot = movieSlots.slotOf(movieId);
+            if (movieSlot < 0 || !ownsUser(userId)) return;
+            int userSlot = userSlots.slotOf(userId);
+            userWriter.add(userSlot, movieSlot, rating);
+            movieWriter.add(movieSlot, userSlot, rating);
+        });
+        if (!userWriter.finish(userStats) || !movieWriter.finish(movieStats)) {
+            cerr << "Error writing rating store next to " << ratingsFile << endl;
+            return false;
+        }
+
+        // Split the cache budget evenly between the two orientations
+        if (!userStore.open(userPath, storeBudget / 2) || !movieStore.open(moviePath, storeBudget / 2)) {
+            cerr << "Error opening rating store next to " << ratingsFile << endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Everything derived from movieStats: popularity, rating-count filter buckets
+    // and a first set of per-query scratch buffers
+    void buildMovieIndexes() {
+        buildPopularity();
+
+        vector<uint32_t> ratingCounts(movieSlots.size());
+        for (size_t slot = 0; slot < ratingCounts.size(); slot++) {
+            ratingCounts[slot] = movieStats.count[slot];
+        }
+        filterIndex.setRatingCounts(std::move(ratingCounts));
+        ScratchLease warmUp(*this); // so the first query does not pay for allocation
+    }
+
+    // Rank rated movies by Bayesian average: (C * globalMean + sum) / (C + count),
+    // where C is the mean number of ratings per rated movie
+    void buildPopularity() {
+        double totalSum = 0;
+        size_t totalCount = 0, ratedMovies = 0;
+        for (size_t slot = 0; slot < movieStats.count.size(); slot++) {
+            totalSum += movieStats.sum[slot];
+            totalCount += movieStats.count[slot];
+            if (movieStats.count[slot] > 0) ratedMovies++;
         }
-        float mean1 = sum1 / n;
-        float mean2 = sum2 / n;
+        globalMean = totalCount > 0 ? static_cast<float>(totalSum / totalCount) : 0.0f;
+        double prior = ratedMovies > 0 ? static_cast<double>(totalCount) / ratedMovies : 0.0;
 
-        // Calculate correlation
-        float numerator = 0, denom1 = 0, denom2 = 0;
-        for (int i = 0; i < n; i++) {
-            float diff1 = r1[i] - mean1;
-            float diff2 = r2[i] - mean2;
-            numerator += diff1 * diff2;
-            denom1 += diff1 * diff1;
-            denom2 += diff2 * diff2;
+        bayesianScore.assign(movieStats.count.size(), 0);
+        popularityOrder.clear();
+        for (size_t slot = 0; slot < movieStats.count.size(); slot++) {
+            if (movieStats.count[slot] == 0) continue;
+            bayesianScore[slot] = static_cast<float>((prior * globalMean + movieStats.sum[slot])
+                                                     / (prior + movieStats.count[slot]));
+            popularityOrder.push_back(static_cast<int>(slot));
         }
+        stable_sort(popularityOrder.begin(), popularityOrder.end(),
+                    [&](int a, int b) { return bayesianScore[a] > bayesianScore[b]; });
+    }
 
-        if (denom1 == 0 || denom2 == 0) return 0.0f;
+    Recommendation makeRecommendation(int slot, float score) const {
+        const Movie& movie = movieNodes[slot]->movie;
+        return {movie.movieId, score, movie.title, &movie.genres};
+    }
 
-        return numerator / (sqrt(denom1) * sqrt(denom2));
+    // Cold-start fallback: emit the most popular eligible movies not already
+    // emitted, flagged fromPopularity since their score is a Bayesian average
+    void fillFromPopularity(RecommendationSink& sink, int count, int excludedSlot,
+                            const RoaringBitmap* candidates, const vector<int>& emitted) const {
+        for (int slot : popularityOrder) {
+            if (count <= 0) break;
+            if (slot == excludedSlot || (candidates && !candidates->contains(slot))) continue;
+            if (find(emitted.begin(), emitted.end(), slot) != emitted.end()) continue;
+            Recommendation rec = makeRecommendation(slot, bayesianScore[slot]);
+            rec.fromPopularity = true;
+            sink.accept(rec);
+            count--;
+        }
     }
 
 public:
+    // Similar users consulted per query (a filtered query keeps going until it has candidates)
+    static constexpr int NEIGHBORHOOD_SIZE = 20;
+
     // CSV parsing helper function
     vector<string> parseCSVLine(const string& line) {
         vector<string> result;
@@ -116,7 +880,12 @@ public:
 
     // Load movies and user ratings from CSV files
     bool loadData(const string& moviesFile, const string& ratingsFile) {
-        // Load movies
+        return loadMovies(moviesFile) && loadRatings(ratingsFile);
+    }
+
+    // Movies only: id/title lookups, catalog browsing and the genre/year
+    // filter indexes work as soon as this returns
+    bool loadMovies(const string& moviesFile) {
         ifstream movieStream(moviesFile);
         if (!movieStream.is_open()) {
             cerr << "Error opening movies file: " << moviesFile << endl;
@@ -148,155 +917,664 @@ public:
                 Movie movie(movieId, title);
                 movie.genres = genres;
 
-                movieTree.insert(movie);
+                if (movieSlots.slotOf(movieId) < 0) {
+                    movieTree.insert(movie);
+                    movieSlots.insert(movieId);
+                    movieNodes.push_back(movieTree.search(movieId));
+                }
             }
         }
 
-        // Load ratings
-        ifstream ratingStream(ratingsFile);
-        if (!ratingStream.is_open()) {
-            cerr << "Error opening ratings file: " << ratingsFile << endl;
-            return false;
+        // Secondary indexes for filtered queries (rating counts arrive with the ratings)
+        for (size_t slot = 0; slot < movieNodes.size(); slot++) {
+            filterIndex.addMovie(slot, movieNodes[slot]->movie.genres, movieNodes[slot]->movie.title);
         }
+        return true;
+    }
 
-        // Skip header
-        getline(ratingStream, line);
-
-        while (getline(ratingStream, line)) {
-            vector<string> fields = parseCSVLine(line);
-            if (fields.size() >= 3) {
-                int userId = stoi(fields[0]);
-                int movieId = stoi(fields[1]);
-                float rating = stof(fields[2]);
-
-                // Update user ratings
-                if (users.find(userId) == users.end()) {
-                    users[userId] = User(userId);
-                }
-                users[userId].movieRatings[movieId] = rating;
+    // Ratings and everything derived from them; loadMovies must have run.
+    // Status lines go to `log`, so a background load can hand them over.
+    bool loadRatings(const string& ratingsFile, ostream& log = cout) {
+        auto startTime = chrono::steady_clock::now();
+        if (storeBudget > 0) {
+            if (!loadRatingsOutOfCore(ratingsFile)) return false;
+        } else {
+            if (!loadRatingsPipelined(ratingsFile)) return false;
 
-                // Update movie ratings
-                auto node = movieTree.search(movieId);
-                if (node != nullptr && node != movieTree.getNIL()) {
-                    node->movie.userRatings[userId] = rating;
-                }
+            // Half-star ratings (all of MovieLens) are kept compressed; anything else stays CSR
+            bool compressed[2];
+            parallelChunks(2, 2, [&](size_t chunk, size_t, size_t) {
+                compressed[chunk] = chunk == 0 ? userPacked.build(userRatings) : moviePacked.build(movieRatings);
+            });
+            if (compressed[0] && compressed[1]) {
+                userRatings = RatingMatrix();
+                movieRatings = RatingMatrix();
+            } else {
+                userPacked = CompressedRatingMatrix();
+                moviePacked = CompressedRatingMatrix();
             }
         }
 
-        cout << "Loaded " << movieTree.inOrder().size() << " movies and " << users.size() << " users" << endl;
+        auto finalizeStart = chrono::steady_clock::now();
+        buildMovieIndexes();
+
+        auto endTime = chrono::steady_clock::now();
+        loadTimings.finalizeMs += chrono::duration<double, milli>(endTime - finalizeStart).count();
+        loadTimings.totalMs = chrono::duration<double, milli>(endTime - startTime).count();
+
+        log << "Loaded " << movieSlots.size() << " movies and " << userSlots.size() << " users" << endl;
+        if (storeBudget == 0) printLoadTimings(log);
         return true;
     }
 
+    const LoadTimings& getLoadTimings() const { return loadTimings; }
+
+    void printLoadTimings(ostream& out = cout) const {
+        out << fixed << setprecision(1) << "Ratings load (" << loadTimings.bytes / (1024.0 * 1024) << " MB): read "
+             << loadTimings.readMs << " ms | parse " << loadTimings.parseMs << " ms (" << loadTimings.parsers
+             << " threads) | shard " << loadTimings.shardMs << " ms (" << loadTimings.shards
+             << " threads) | finalize " << loadTimings.finalizeMs << " ms | wall " << loadTimings.totalMs
+             << " ms" << endl;
+    }
+
     // Get movie recommendations for a user based on a movie they liked
-    vector<pair<Movie, float>> getRecommendations(int movieId, int numRecs = 5) {
+    vector<Recommendation> getRecommendations(int movieId, int numRecs = 5) {
         auto startTime = chrono::high_resolution_clock::now();
 
-        // Find similar users who liked this movie
-        vector<pair<int, float>> similarUsers = findSimilarUsers(movieId, 20);
+        VectorSink sink;
+        computeRecommendations(movieId, numRecs, metric, nullptr, nullptr, nullptr, sink);
+
+        auto endTime = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::milliseconds>(endTime - startTime).count();
+
+        cout << "Recommendation generation took " << duration << " ms" << endl;
 
-        // Use a map to accumulate weighted ratings
-        map<int, pair<float, float>> movieScores; // movieId -> (weighted sum, similarity sum)
+        return sink.results;
+    }
 
-        // For each similar user, get their highly rated movies
-        for (const auto& [userId, similarity] : similarUsers) {
-            if (similarity <= 0) continue; // Skip negatively correlated users
+    // Streaming variant: results go straight to the sink, best first
+    void getRecommendations(int movieId, int numRecs, RecommendationSink& sink) {
+        computeRecommendations(movieId, numRecs, metric, nullptr, nullptr, nullptr, sink);
+    }
 
-            const User& user = users[userId];
-            for (const auto& [recMovieId, rating] : user.movieRatings) {
-                // Skip the input movie and low ratings
-                if (recMovieId == movieId || rating < 3.5) continue;
+    // Anytime variant: returns the best top-N found within the latency budget
+    AnytimeRecommendations getRecommendations(int movieId, int numRecs, chrono::microseconds budget) {
+        Deadline deadline(budget);
+        AnytimeRecommendations result;
+        VectorSink sink;
+        computeRecommendations(movieId, numRecs, metric, &deadline, &result.exact, nullptr, sink);
+        result.recommendations = std::move(sink.results);
+        return result;
+    }
 
-                // Weight the rating by user similarity
-                auto& scoreData = movieScores[recMovieId];
-                scoreData.first += similarity * rating;
-                scoreData.second += similarity;
-            }
+    // Filtered variant: only movies matching the filter are ever scored
+    void getRecommendations(int movieId, int numRecs, const MovieFilter& filter, RecommendationSink& sink) {
+        if (filter.empty()) {
+            computeRecommendations(movieId, numRecs, metric, nullptr, nullptr, nullptr, sink);
+            return;
         }
+        getRecommendations(movieId, numRecs, filterIndex.resolve(filter), sink);
+    }
 
-        // Use a priority queue to get top N recommendations
-        using MovieScore = pair<float, int>; // score, movieId
-        priority_queue<MovieScore> pq;
+    // Same, for a filter already resolved with resolveFilter
+    void getRecommendations(int movieId, int numRecs, const RoaringBitmap& candidates, RecommendationSink& sink) {
+        if (candidates.empty()) return;
+        computeRecommendations(movieId, numRecs, metric, nullptr, nullptr, &candidates, sink);
+    }
+
+    vector<Recommendation> getRecommendations(int movieId, int numRecs, const MovieFilter& filter) {
+        VectorSink sink;
+        getRecommendations(movieId, numRecs, filter, sink);
+        return sink.results;
+    }
+
+    // Most popular movies by Bayesian-average rating, optionally filtered
+    void getPopularMovies(int numRecs, const MovieFilter& filter, RecommendationSink& sink) {
+        if (filter.empty()) {
+            fillFromPopularity(sink, numRecs, -1, nullptr, {});
+        } else {
+            RoaringBitmap candidates = filterIndex.resolve(filter);
+            fillFromPopularity(sink, numRecs, -1, &candidates, {});
+        }
+    }
+
+    vector<Recommendation> getPopularMovies(int numRecs, const MovieFilter& filter = MovieFilter()) {
+        VectorSink sink;
+        getPopularMovies(numRecs, filter, sink);
+        return sink.results;
+    }
+
+    // Movie slots matching a filter. Slots follow forEachMovie order, so this
+    // bitmap also addresses indexes built in that order (e.g. TagIndex docs).
+    RoaringBitmap resolveFilter(const MovieFilter& filter) const {
+        return filterIndex.resolve(filter);
+    }
 
-        for (const auto& [recMovieId, scoreData] : movieScores) {
-            if (scoreData.second > 0) {
-                float normalizedScore = scoreData.first / scoreData.second;
-                pq.push({normalizedScore, recMovieId});
+private:
+    void computeRecommendations(int movieId, int numRecs, SimilarityMetric queryMetric, const Deadline* deadline,
+                                bool* exact, const RoaringBitmap* candidates, RecommendationSink& sink) {
+        int movieSlot = movieSlots.slotOf(movieId);
+        if (movieSlot < 0) return;
+        ScratchLease scratch(*this);
+
+        // Accumulate weighted ratings per movie slot: (weighted sum, similarity sum)
+        MovieAccumulator& movieScores = scratch->scores;
+
+        // Find similar users who liked this movie. Unfiltered exact queries use a
+        // fixed neighbourhood, so a heavy one can be accumulated in parallel.
+        if (!deadline && !candidates) {
+            accumulateNeighbours(*scratch, movieSlot,
+                                 findSimilarUsers(*scratch, movieSlot, NEIGHBORHOOD_SIZE, queryMetric));
+            emitTopScores(*scratch, movieSlot, numRecs, candidates, sink);
+            return;
+        }
+
+        // The rest stop adaptively and stay serial. A filter can leave the top
+        // neighbours with too few matching movies, so filtered queries keep every
+        // rater's score but sort them in growing blocks, only as far as needed.
+        int limit = candidates ? static_cast<int>(movieStats.count[movieSlot]) : NEIGHBORHOOD_SIZE;
+        vector<pair<float, int>> ranked = rankSimilarUsers(*scratch, movieSlot, limit, queryMetric, deadline, exact);
+        size_t rankedEnd = 0;
+        size_t accumulated = 0;
+        for (size_t next = 0; next < ranked.size(); next++) {
+            if (next == rankedEnd) {
+                rankedEnd = min(ranked.size(), max<size_t>(NEIGHBORHOOD_SIZE, rankedEnd * 4));
+                partial_sort(ranked.begin() + next, ranked.begin() + rankedEnd, ranked.end(), greater<>());
             }
+            auto [similarity, userSlot] = ranked[next];
+            if (similarity <= 0) break; // Skip negatively correlated users (and everyone after them)
+
+            // Similar users are in descending order, so stopping here keeps the strongest signal
+            if (deadline && accumulated > 0 && deadline->expired()) {
+                if (exact) *exact = false;
+                break;
+            }
+            if (accumulated >= static_cast<size_t>(NEIGHBORHOOD_SIZE)
+                && movieScores.touched.size() >= static_cast<size_t>(numRecs)) {
+                break;
+            }
+            accumulated++;
+
+            forEachUserRating(userSlot, [&](int recSlot, float rating) {
+                // Skip the input movie, low ratings and anything the filter excludes
+                if (recSlot == movieSlot || rating < 3.5) return;
+                if (candidates && !candidates->contains(recSlot)) return;
+
+                // Weight the rating by user similarity
+                movieScores.add(recSlot, similarity * rating, similarity);
+            });
+        }
+
+        emitTopScores(*scratch, movieSlot, numRecs, candidates, sink);
+    }
+
+    // Add every positively similar neighbour's liked movies (other than movieSlot)
+    // to scratch.scores as (similarity * rating, similarity)
+    void accumulateNeighbours(QueryScratch& scratch, int movieSlot, const vector<pair<int, float>>& similarUsers) {
+        size_t work = 0;
+        for (const auto& [userSlot, similarity] : similarUsers) {
+            if (similarity > 0) work += userStats.count[userSlot];
+        }
+        accumulateUsers(scratch, similarUsers.size(), work, scratch.scores, [&](size_t i, auto&& add) {
+            auto [userSlot, similarity] = similarUsers[i];
+            if (similarity <= 0) return;
+            forEachUserRating(userSlot, [&](int recSlot, float rating) {
+                if (recSlot == movieSlot || rating < 3.5) return;
+                add(recSlot, similarity * rating, similarity);
+            });
+        });
+    }
+
+    // Rank the (weighted sum, similarity sum) pairs in scratch.scores, stream the
+    // best numRecs to the sink and top up from popularity; clears the scores
+    void emitTopScores(QueryScratch& scratch, int movieSlot, int numRecs, const RoaringBitmap* candidates,
+                       RecommendationSink& sink) {
+        MovieAccumulator& movieScores = scratch.scores;
+
+        // Bounded top-N selection over the touched movies
+        TopK best(max(numRecs, 0));
+        for (int recSlot : movieScores.touched) {
+            best.push(movieScores.first[recSlot] / movieScores.second[recSlot], recSlot);
+        }
+        movieScores.clear();
+
+        // Stream top recommendations to the sink
+        vector<int> emitted;
+        for (const auto& [score, recSlot] : best.sorted()) {
+            sink.accept(makeRecommendation(recSlot, score));
+            emitted.push_back(recSlot);
+        }
+
+        // Movies with no usable neighbours (e.g. no ratings yet) fall back to popularity
+        if (static_cast<int>(emitted.size()) < numRecs) {
+            fillFromPopularity(sink, numRecs - static_cast<int>(emitted.size()), movieSlot, candidates, emitted);
+        }
+    }
+
+public:
+    // Hybrid of collaborative filtering, content similarity and popularity in
+    // one ranked list under a single blend. It costs about as much as running
+    // the two engines back to back; the blend's bounds keep the content side
+    // from adding more than that:
+    //   1. CF candidates get their CF and prior terms from slot-indexed arrays
+    //      and need a cosine only while CF + prior + the full content weight
+    //      could still beat the top-N threshold.
+    //   2. Content-only candidates come from the content engine's top-N with a
+    //      score floor: the cosine a movie needs to enter with the top prior,
+    //      so MaxScore prunes from the first posting.
+    //   3. The most popular movies join the same way, when their best possible
+    //      blend could still enter.
+    // `content` must have registered its documents in movie slot order.
+    void getHybridRecommendations(int movieId, int numRecs, const TagIndex& content, const HybridWeights& weights,
+                                  RecommendationSink& sink) {
+        int movieSlot = movieSlots.slotOf(movieId);
+        if (movieSlot < 0) return;
+        ScratchLease scratch(*this);
+
+        // Collaborative candidates: (weighted sum, similarity sum) per slot
+        MovieAccumulator& collaborative = scratch->scores;
+        if (weights.collaborative > 0) {
+            accumulateNeighbours(*scratch, movieSlot, findSimilarUsers(*scratch, movieSlot, NEIGHBORHOOD_SIZE, metric));
+        }
+
+        int queryDoc = content.numDocuments() == movieSlots.size() ? content.docFor(movieId) : -1;
+        bool useContent = weights.content > 0 && queryDoc >= 0;
+        // CF means overwrite the CF sums, so untouched slots read a CF term of 0
+        float* cf = collaborative.first.data();
+        const float* cfWeight = collaborative.second.data();
+        for (int slot : collaborative.touched) cf[slot] /= cfWeight[slot];
+        const float* prior = bayesianScore.data();
+        const float cfScale = weights.collaborative / 5.0f;
+        const float priorScale = weights.popularity / 5.0f;
+        vector<float> queryTerms;
+        if (useContent) content.expand(queryDoc, queryTerms);
+        auto blend = [&](int slot) {
+            float cosine = useContent ? content.dot(queryTerms, slot) : 0.0f;
+            return cfScale * cf[slot] + weights.content * cosine + priorScale * prior[slot];
+        };
+        TopK best(max(numRecs, 0), collaborative.touched.size());
+        auto score = [&](int slot) { best.push(blend(slot), slot); };
+
+        // A CF candidate needs a cosine only while CF + prior + the full
+        // content weight (cosine is at most 1) could still enter
+        const float maxContent = useContent ? weights.content : 0.0f;
+        for (int slot : collaborative.touched) {
+            float bound = cfScale * cf[slot] + priorScale * prior[slot] + maxContent;
+            if (best.full() && bound < best.threshold()) continue;
+            score(slot);
         }
 
-        // Extract top recommendations
-        vector<pair<Movie, float>> recommendations;
-        int count = 0;
-        while (!pq.empty() && count < numRecs) {
-            auto [score, recMovieId] = pq.top();
-            pq.pop();
+        // A content-only candidate scores at most content * cosine + the top
+        // prior, so it needs a cosine above `floor` to enter. The content top-N
+        // prunes its postings from that floor, and no movie left out has a
+        // higher cosine than its last entry (or than the floor, if it came back short).
+        float maxPrior = popularityOrder.empty() ? 0.0f : priorScale * prior[popularityOrder.front()];
+        float otherCosine = useContent ? 1.0f : 0.0f;
+        vector<int> contentSlots;
+        float floor = best.full() && useContent ? (best.threshold() - maxPrior) / weights.content : 0.0f;
+        if (useContent && floor < 1.0f) {
+            floor = max(floor, 0.0f);
+            auto similar = content.topN(movieId, max(numRecs, 0), nullptr, floor);
+            for (const auto& [recMovieId, similarity] : similar) {
+                int slot = movieSlots.slotOf(recMovieId);
+                if (slot >= 0 && cfWeight[slot] == 0) {
+                    score(slot);
+                    contentSlots.push_back(slot);
+                }
+            }
+            otherCosine = static_cast<int>(similar.size()) < numRecs ? floor : similar.back().second;
+        }
 
-            auto node = movieTree.search(recMovieId);
-            if (node != nullptr && node != movieTree.getNIL()) {
-                recommendations.push_back({node->movie, score});
-                count++;
+        // Popularity candidates: the top numRecs movies by prior not scored yet,
+        // under the same blend and in the same top-N rather than appended with
+        // raw Bayesian averages; skipped when even the top prior cannot enter
+        float otherContent = weights.content * otherCosine;
+        int popular = max(numRecs, 0);
+        if (!(best.full() && best.threshold() >= maxPrior + otherContent)) {
+            for (int slot : popularityOrder) {
+                if (popular == 0) break;
+                if (slot == movieSlot || cfWeight[slot] > 0) continue;
+                if (find(contentSlots.begin(), contentSlots.end(), slot) != contentSlots.end()) continue;
+                score(slot);
+                popular--;
             }
         }
+        collaborative.clear();
 
-        auto endTime = chrono::high_resolution_clock::now();
-        auto duration = chrono::duration_cast<chrono::milliseconds>(endTime - startTime).count();
+        for (const auto& [blended, recSlot] : best.sorted()) {
+            sink.accept(makeRecommendation(recSlot, blended));
+        }
+    }
 
-        cout << "Recommendation generation took " << duration << " ms" << endl;
+    // Sharded serving hooks. Users are partitioned across processes by id; each
+    // shard answers the user-side steps of a query for its own users, and a
+    // coordinator holding only the movies merges the partial results:
+    //   1. partialProfile sums per movie from the shard's raters of the query movie
+    //   2. scoreShardRaters ranks the shard's raters against the merged profile means
+    //   3. partialScores accumulates the chosen neighbours' liked movies
+    //   4. recommendFromScores ranks the merged sums and fills from popularity
+    // Every shard must see the global movie aggregates (setMovieAggregates),
+    // since adjusted cosine and popularity read them.
+    struct ProfilePart {
+        int movieSlot;
+        float sum;
+        float count;
+    };
 
-        return recommendations;
+    struct ProfileMean {
+        int movieSlot;
+        float mean;
+    };
+
+    struct SimilarUser {
+        int userId;
+        float similarity;
+    };
+
+    struct ScorePart {
+        int movieSlot;
+        float weightedSum;
+        float similaritySum;
+    };
+
+    // Must be called before loadRatings
+    void restrictToShard(int shard, int numShards) {
+        shardIndex = shard;
+        shardCount = max(numShards, 1);
     }
 
-    // Performance analysis
-    void analyzePerformance(int numTests = 100) {
-        vector<int> movieIds = getRandomMovieIds(numTests);
-        long long totalTime = 0;
+    bool ownsUser(int userId) const {
+        return shardCount == 1 || static_cast<unsigned>(userId) % shardCount == static_cast<unsigned>(shardIndex);
+    }
+
+    vector<ProfilePart> partialProfile(int movieId) {
+        vector<ProfilePart> parts;
+        int movieSlot = movieSlots.slotOf(movieId);
+        if (movieSlot < 0) return parts;
+
+        vector<int> raters;
+        size_t work = 0;
+        forEachMovieRating(movieSlot, [&](int userSlot, float) {
+            raters.push_back(userSlot);
+            work += userStats.count[userSlot];
+        });
+
+        ScratchLease scratch(*this);
+        MovieAccumulator& profile = scratch->profile;
+        accumulateUsers(*scratch, raters.size(), work, profile, [&](size_t i, auto&& add) {
+            forEachUserRating(raters[i], [&](int ratedSlot, float ratedValue) {
+                if (ratedSlot != movieSlot) add(ratedSlot, ratedValue, 1.0f);
+            });
+        });
+        parts.reserve(profile.touched.size());
+        for (int slot : profile.touched) parts.push_back({slot, profile.first[slot], profile.second[slot]});
+        profile.clear();
+        return parts;
+    }
+
+    // This shard's k most similar raters of the movie, most similar first
+    vector<SimilarUser> scoreShardRaters(int movieId, const vector<ProfileMean>& means, int k) {
+        vector<SimilarUser> result;
+        int movieSlot = movieSlots.slotOf(movieId);
+        if (movieSlot < 0) return result;
+
+        ScratchLease scratch(*this);
+        MovieAccumulator& profile = scratch->profile;
+        size_t profileLiked = 0;
+        for (const ProfileMean& entry : means) {
+            profile.add(entry.movieSlot, entry.mean, 1.0f);
+            profileLiked += entry.mean >= LIKE_THRESHOLD;
+        }
+
+        vector<pair<int, float>> raters;
+        size_t work = 0;
+        forEachMovieRating(movieSlot, [&](int userSlot, float rating) {
+            raters.push_back({userSlot, rating});
+            work += userStats.count[userSlot];
+        });
+        bool parallel = work >= PARALLEL_MIN_RATINGS && ThreadPool::concurrency() > 1;
+
+        TopK best = withMetricPolicies(metric, [&](auto similarity, auto overlap) {
+            return scoreRaters<decltype(similarity), decltype(overlap)>(movieSlot, raters, raters.size(), profile.first,
+                                                                        profileLiked, movieStats.mean.data(), k,
+                                                                        parallel, nullptr, nullptr);
+        });
+        profile.clear();
+
+        for (const auto& [similarity, userSlot] : best.sorted()) {
+            result.push_back({userSlots.idOf(userSlot), similarity});
+        }
+        return result;
+    }
+
+    // (weighted sum, similarity sum) per movie over the given neighbours this shard owns
+    vector<ScorePart> partialScores(int movieId, const vector<SimilarUser>& users) {
+        vector<ScorePart> parts;
+        int movieSlot = movieSlots.slotOf(movieId);
+        if (movieSlot < 0) return parts;
+
+        ScratchLease scratch(*this);
+        MovieAccumulator& movieScores = scratch->scores;
+        for (const SimilarUser& user : users) {
+            int userSlot = userSlots.slotOf(user.userId);
+            if (userSlot < 0 || user.similarity <= 0) continue;
+            forEachUserRating(userSlot, [&](int recSlot, float rating) {
+                if (recSlot == movieSlot || rating < 3.5) return;
+                movieScores.add(recSlot, user.similarity * rating, user.similarity);
+            });
+        }
+        parts.reserve(movieScores.touched.size());
+        for (int slot : movieScores.touched) parts.push_back({slot, movieScores.first[slot], movieScores.second[slot]});
+        movieScores.clear();
+        return parts;
+    }
+
+    // Final step on the coordinator: rank merged score sums like getRecommendations
+    void recommendFromScores(int movieId, int numRecs, const vector<ScorePart>& parts, RecommendationSink& sink) {
+        int movieSlot = movieSlots.slotOf(movieId);
+        if (movieSlot < 0) return;
+        ScratchLease scratch(*this);
+        for (const ScorePart& part : parts) scratch->scores.add(part.movieSlot, part.weightedSum, part.similaritySum);
+        emitTopScores(*scratch, movieSlot, numRecs, nullptr, sink);
+    }
+
+    const RatingAggregates& getMovieAggregates() const { return movieStats; }
+
+    // Replace the per-movie aggregates (e.g. with totals over all shards) and
+    // rebuild popularity and the rating-count filter from them
+    void setMovieAggregates(RatingAggregates aggregates) {
+        movieStats = std::move(aggregates);
+        buildMovieIndexes();
+    }
+
+private:
+    // Leave-one-out prediction of heldOutUser's rating of movieSlot. Neighbours
+    // are chosen exactly as a recommendation query chooses them (raters ranked
+    // against the movie's audience profile), with the held-out user dropped
+    // from the raters and the held-out rating from the item means; the best
+    // positive neighbours' ratings of the movie are averaged by similarity.
+    template <typename Similarity, typename Overlap>
+    double predictHeldOut(QueryScratch& scratch, int movieSlot, int heldOutUser, float heldOutRating) {
+        float heldOutMean = (movieStats.sum[movieSlot] - heldOutRating) / (movieStats.count[movieSlot] - 1);
+        vector<float> itemMean(movieStats.mean);
+        itemMean[movieSlot] = heldOutMean;
 
+        unordered_map<int, float> neighbours; // user slot -> similarity
+        for (const auto& [similarity, userSlot] : findSimilarUsersWith<Similarity, Overlap>(
+                 scratch, movieSlot, NEIGHBORHOOD_SIZE, nullptr, nullptr, heldOutUser, itemMean.data())) {
+            if (similarity > 0) neighbours.emplace(userSlot, similarity);
+        }
+
+        double weighted = 0, weights = 0;
+        forEachMovieRating(movieSlot, [&](int userSlot, float rating) {
+            auto it = neighbours.find(userSlot);
+            if (it == neighbours.end()) return;
+            weighted += it->second * rating;
+            weights += it->second;
+        });
+        if (weights > 0) return weighted / weights;
+
+        // No usable neighbour: the movie's mean without the held-out rating
+        return heldOutMean;
+    }
+
+public:
+    // Latency and accuracy of one similarity metric over a fixed movie sample
+    struct MetricReport {
+        double avgMicros = 0;
+        double p99Micros = 0;
+        double mae = 0;
+        size_t predictions = 0;
+    };
+
+    // Latency covers the full recommendation query. Accuracy holds out one
+    // random rating of each sampled movie, predicts it with predictHeldOut
+    // (the held-out user takes no part in choosing or weighting neighbours)
+    // and reports the MAE.
+    MetricReport benchmarkMetric(SimilarityMetric candidate, const vector<int>& movieIds) {
+        MetricReport report;
+
+        vector<double> latencies;
         for (int movieId : movieIds) {
+            VectorSink sink;
             auto startTime = chrono::high_resolution_clock::now();
+            computeRecommendations(movieId, 5, candidate, nullptr, nullptr, nullptr, sink);
+            auto endTime = chrono::high_resolution_clock::now();
+            latencies.push_back(chrono::duration<double, micro>(endTime - startTime).count());
+        }
+        if (!latencies.empty()) {
+            sort(latencies.begin(), latencies.end());
+            for (double t : latencies) report.avgMicros += t;
+            report.avgMicros /= latencies.size();
+            report.p99Micros = latencies[min(latencies.size() - 1, latencies.size() * 99 / 100)];
+        }
 
-            getRecommendations(movieId, 5);
+        mt19937 gen(42); // same held-out raters for every metric
+        double absError = 0;
+        for (int movieId : movieIds) {
+            int movieSlot = movieSlots.slotOf(movieId);
+            if (movieSlot < 0 || movieStats.count[movieSlot] < 2) continue;
 
-            auto endTime = chrono::high_resolution_clock::now();
-            auto duration = chrono::duration_cast<chrono::milliseconds>(endTime - startTime).count();
-            totalTime += duration;
+            auto [heldOutUser, actual] = movieRatingAt(movieSlot, gen() % movieStats.count[movieSlot]);
+
+            ScratchLease scratch(*this);
+            double predicted = withMetricPolicies(candidate, [&](auto similarity, auto overlap) {
+                return predictHeldOut<decltype(similarity), decltype(overlap)>(*scratch, movieSlot, heldOutUser,
+                                                                               actual);
+            });
+            absError += fabs(predicted - actual);
+            report.predictions++;
         }
+        report.mae = report.predictions > 0 ? absError / report.predictions : 0;
+        return report;
+    }
 
-        cout << "Average recommendation time: " << (totalTime / numTests) << " ms" << endl;
+    // Performance analysis: every metric on the same random movies, side by side
+    void analyzePerformance(int numTests = 100) {
+        vector<int> movieIds = getRandomMovieIds(numTests);
 
-        // Memory usage analysis
-        size_t totalMovieRatings = 0;
-        for (auto& node : movieTree.inOrder()) {
-            totalMovieRatings += node.userRatings.size();
+        cout << left << setw(18) << "Metric" << right << setw(12) << "Avg (us)" << setw(12) << "p99 (us)"
+             << setw(10) << "MAE" << setw(8) << "N" << endl;
+        for (SimilarityMetric candidate : ALL_SIMILARITY_METRICS) {
+            MetricReport report = benchmarkMetric(candidate, movieIds);
+            cout << left << setw(18) << similarityMetricName(candidate) << right << fixed
+                 << setprecision(1) << setw(12) << report.avgMicros << setw(12) << report.p99Micros
+                 << setprecision(3) << setw(10) << report.mae << setw(8) << report.predictions
+                 << (candidate == metric ? "  (selected)" : "") << endl;
         }
 
-        size_t totalUserRatings = 0;
-        for (const auto& [userId, user] : users) {
-            totalUserRatings += user.movieRatings.size();
+        // Memory usage analysis
+        cout << "Filter indexes (genre, year, rating count): " << fixed << setprecision(1)
+             << filterIndex.sizeInBytes() / 1024.0 << " KB" << endl;
+        if (userStore.isOpen()) {
+            printStoreStatistics();
+            return;
+        }
+        if (!userPacked.empty()) {
+            printCompressionStatistics();
+            return;
         }
+        size_t totalMovieRatings = movieRatings.nonZeros();
+        size_t totalUserRatings = userRatings.nonZeros();
 
         cout << "Memory usage statistics:" << endl;
         cout << "Total movie ratings: " << totalMovieRatings << endl;
         cout << "Total user ratings: " << totalUserRatings << endl;
         cout << "Approximate memory for ratings: "
-             << (totalMovieRatings + totalUserRatings) * sizeof(pair<int, float>) / (1024 * 1024)
+             << ((totalMovieRatings + totalUserRatings) * (sizeof(int) + sizeof(float))
+                 + (movieRatings.offsets.size() + userRatings.offsets.size()) * sizeof(uint32_t)) / (1024 * 1024)
              << " MB" << endl;
     }
 
-    // Get some random movie IDs for testing
+    // Compressed size against the plain CSR layout, and full-scan decode speed
+    void printCompressionStatistics() const {
+        size_t ratings = userPacked.nonZeros();
+        size_t packedBytes = userPacked.sizeInBytes() + moviePacked.sizeInBytes();
+        size_t plainBytes = 2 * ratings * (sizeof(int) + sizeof(float))
+                            + (userPacked.rows() + moviePacked.rows() + 2) * sizeof(uint32_t);
+
+        // Decode every user row once; decoded bytes are what the CSR layout would have streamed
+        auto start = chrono::high_resolution_clock::now();
+        double checksum = 0;
+        for (size_t slot = 0; slot < userPacked.rows(); slot++) {
+            userPacked.forEachInRow(static_cast<int>(slot), [&](int movieSlot, float rating) {
+                checksum += rating + movieSlot;
+            });
+        }
+        double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+        double decodedBytes = static_cast<double>(ratings) * (sizeof(int) + sizeof(float));
+
+        cout << "Memory usage statistics:" << endl;
+        cout << "Total ratings: " << ratings << " (stored twice: by user and by movie)" << endl;
+        cout << fixed << setprecision(2) << "Compressed ratings: " << packedBytes / (1024.0 * 1024) << " MB, "
+             << static_cast<double>(packedBytes) / (2 * ratings) << " bytes/rating (plain CSR: "
+             << plainBytes / (1024.0 * 1024) << " MB, " << static_cast<double>(plainBytes) / (2 * ratings)
+             << " bytes/rating)" << endl;
+        if (seconds > 0) {
+            cout << "Decode: " << decodedBytes / seconds / 1e9 << " GB/s ("
+                 << ratings / seconds / 1e6 << " M ratings/s, checksum " << setprecision(0) << checksum << ")" << endl;
+        }
+    }
+
+    // Serve ratings from on-disk stores with at most budgetBytes of cached
+    // blocks; call before loadData. Zero keeps everything in memory.
+    void enableOutOfCore(size_t budgetBytes) { storeBudget = budgetBytes; }
+    bool isOutOfCore() const { return userStore.isOpen(); }
+
+    // Disk reads, cache hit rates and resident bytes of both rating stores
+    void printStoreStatistics() const {
+        cout << "Out-of-core rating store (cache budget " << storeBudget / (1024 * 1024) << " MB):" << endl;
+        cout << left << setw(8) << "Store" << right << setw(12) << "Ratings" << setw(12) << "File (MB)"
+             << setw(14) << "Resident (MB)" << setw(12) << "Read (MB)" << setw(12) << "Hits"
+             << setw(10) << "Misses" << setw(10) << "Hit rate" << endl;
+        auto printRow = [](const string& name, const RatingStore& store) {
+            RatingStoreStats s = store.stats();
+            cout << left << setw(8) << name << right << setw(12) << store.nonZeros() << fixed << setprecision(1)
+                 << setw(12) << s.fileBytes / (1024.0 * 1024) << setw(14) << s.residentBytes / (1024.0 * 1024)
+                 << setw(12) << s.bytesRead / (1024.0 * 1024) << setw(12) << s.hits << setw(10) << s.misses
+                 << setprecision(3) << setw(10) << s.hitRate() << endl;
+        };
+        printRow("users", userStore);
+        printRow("movies", movieStore);
+    }
+
+    void setSimilarityMetric(SimilarityMetric m) { metric = m; }
+    SimilarityMetric getSimilarityMetric() const { return metric; }
+
+    // Get some random movie IDs for testing (O(log n) per pick via select)
     vector<int> getRandomMovieIds(int count) {
-        vector<Movie> allMovies = movieTree.inOrder();
         vector<int> ids;
+        int total = movieTree.size();
 
-        if (allMovies.empty()) return ids;
+        if (total == 0) return ids;
 
         // Pick random movies
         random_device rd;
         mt19937 gen(rd());
-        uniform_int_distribution<> distrib(0, allMovies.size() - 1);
+        uniform_int_distribution<> distrib(0, total - 1);
 
-        for (int i = 0; i < count && !allMovies.empty(); i++) {
-            int index = distrib(gen);
-            ids.push_back(allMovies[index].movieId);
+        for (int i = 0; i < count; i++) {
+            ids.push_back(movieTree.select(distrib(gen))->movie.movieId);
         }
 
         return ids;
@@ -304,20 +1582,46 @@ public:
 
     // Get all movie ids
     vector<int> getAllMovieIds() {
-        vector<Movie> allMovies = movieTree.inOrder();
         vector<int> ids;
-        ids.reserve(allMovies.size());
+        ids.reserve(movieTree.size());
 
-        for (const auto& movie : allMovies) {
-            ids.push_back(movie.movieId);
+        for (MovieNode* node : movieTree.range()) {
+            ids.push_back(node->movie.movieId);
         }
 
         return ids;
     }
 
-    // expose the raw MovieNode* search (for content filtering)
+    // One page of the catalog in id order: `limit` movies starting at position `offset`
+    vector<MovieNode*> getCatalogPage(int offset, int limit) {
+        vector<MovieNode*> page;
+        MovieNode* first = movieTree.select(offset);
+        if (first == movieTree.getNIL()) return page;
+
+        for (MovieNode* node : movieTree.range(first->movie.movieId)) {
+            if (static_cast<int>(page.size()) >= limit) break;
+            page.push_back(node);
+        }
+        return page;
+    }
+
+    // Visit every movie in slot order
+    template <typename F>
+    void forEachMovie(F&& f) const {
+        for (const MovieNode* node : movieNodes) {
+            f(node->movie);
+        }
+    }
+
+    // Position of movieId in id order and number of movies in an id range
+    int getMovieRank(int movieId) { return movieTree.rank(movieId); }
+    int countMoviesInRange(int lowId, int highId) { return movieTree.count(lowId, highId); }
+    int getMovieCount() const { return movieTree.size(); }
+
+    // expose the raw MovieNode* search (for content filtering); nullptr if absent
     MovieNode* getMovieNode(int movieId) {
-        return movieTree.search(movieId);
+        MovieNode* node = movieTree.search(movieId);
+        return node == movieTree.getNIL() ? nullptr : node;
     }
 
     // get all movies (in‑order) for iterating in content filtering
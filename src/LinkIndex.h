@@ -0,0 +1,172 @@
+#ifndef LINKINDEX_H
+#define LINKINDEX_H
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+// Upstream identifier schemes found in links.csv
+enum class ExternalIdKind { IMDB, TMDB };
+
+// External identifiers for one movie; -1 when links.csv has no value
+struct ExternalIds {
+    int imdbId = -1;
+    int tmdbId = -1;
+};
+
+// Read-only movieId <-> imdbId/tmdbId index built from links.csv.
+// Each direction is a pair of sorted flat arrays (keys, values) searched
+// with a branch-free binary search; no per-entry allocation or hashing.
+class LinkIndex {
+private:
+    struct SortedMap {
+        vector<int> keys;
+        vector<int> values;
+
+        void build(vector<pair<int, int>>& entries) {
+            sort(entries.begin(), entries.end());
+            keys.resize(entries.size());
+            values.resize(entries.size());
+            for (size_t i = 0; i < entries.size(); i++) {
+                keys[i] = entries[i].first;
+                values[i] = entries[i].second;
+            }
+        }
+
+        // Index of the first key >= key without data-dependent branches
+        size_t lowerBound(int key) const {
+            const int* base = keys.data();
+            size_t n = keys.size();
+            while (n > 1) {
+                size_t half = n / 2;
+                base = (base[half - 1] < key) ? base + half : base;
+                n -= half;
+            }
+            size_t pos = base - keys.data();
+            return (n == 1 && *base < key) ? pos + 1 : pos;
+        }
+
+        int find(int key, int missing) const {
+            size_t pos = lowerBound(key);
+            return (pos < keys.size() && keys[pos] == key) ? values[pos] : missing;
+        }
+    };
+
+    SortedMap imdbToMovie;
+    SortedMap tmdbToMovie;
+    SortedMap movieToImdb;
+    SortedMap movieToTmdb;
+
+    static int parseId(const string& field) {
+        if (field.empty()) return -1;
+        try {
+            return stoi(field);
+        } catch (...) {
+            return -1;
+        }
+    }
+
+    const SortedMap& externalMap(ExternalIdKind kind) const {
+        return kind == ExternalIdKind::IMDB ? imdbToMovie : tmdbToMovie;
+    }
+
+public:
+    // Load links.csv (movieId,imdbId,tmdbId)
+    bool load(const string& filename) {
+        ifstream file(filename);
+        if (!file.is_open()) {
+            cerr << "Links file not found (" << filename << "), external ids unavailable" << endl;
+            return false;
+        }
+
+        vector<pair<int, int>> imdb, tmdb, byMovieImdb, byMovieTmdb;
+        string line;
+        // Skip header
+        getline(file, line);
+
+        while (getline(file, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            stringstream ss(line);
+            string movieStr, imdbStr, tmdbStr;
+            getline(ss, movieStr, ',');
+            getline(ss, imdbStr, ',');
+            getline(ss, tmdbStr, ',');
+
+            int movieId = parseId(movieStr);
+            if (movieId < 0) continue;
+            int imdbId = parseId(imdbStr);
+            int tmdbId = parseId(tmdbStr);
+            if (imdbId >= 0) {
+                imdb.push_back({imdbId, movieId});
+                byMovieImdb.push_back({movieId, imdbId});
+            }
+            if (tmdbId >= 0) {
+                tmdb.push_back({tmdbId, movieId});
+                byMovieTmdb.push_back({movieId, tmdbId});
+            }
+        }
+
+        imdbToMovie.build(imdb);
+        tmdbToMovie.build(tmdb);
+        movieToImdb.build(byMovieImdb);
+        movieToTmdb.build(byMovieTmdb);
+        return true;
+    }
+
+    size_t size() const { return movieToImdb.keys.size(); }
+
+    // External id -> movieId, or -1 if unknown
+    int toMovieId(ExternalIdKind kind, int externalId) const {
+        return externalMap(kind).find(externalId, -1);
+    }
+
+    // movieId -> external ids
+    ExternalIds toExternal(int movieId) const {
+        ExternalIds ids;
+        ids.imdbId = movieToImdb.find(movieId, -1);
+        ids.tmdbId = movieToTmdb.find(movieId, -1);
+        return ids;
+    }
+
+    // Resolve many external ids at once. Queries run in groups of BATCH
+    // branch-free binary searches stepped in lockstep, so the groups' cache
+    // misses overlap instead of serializing; results keep input order.
+    void resolveBatch(ExternalIdKind kind, const vector<int>& externalIds, vector<int>& movieIds) const {
+        constexpr size_t BATCH = 16;
+        const SortedMap& map = externalMap(kind);
+        movieIds.resize(externalIds.size());
+        const size_t n = map.keys.size();
+        if (n == 0) {
+            fill(movieIds.begin(), movieIds.end(), -1);
+            return;
+        }
+
+        const int* keys = map.keys.data();
+        const int* base[BATCH];
+        for (size_t first = 0; first < externalIds.size(); first += BATCH) {
+            size_t count = min(BATCH, externalIds.size() - first);
+            const int* query = externalIds.data() + first;
+            for (size_t j = 0; j < count; j++) base[j] = keys;
+
+            // Every search in the group has the same remaining length at each step
+            for (size_t len = n; len > 1; len -= len / 2) {
+                size_t half = len / 2;
+                for (size_t j = 0; j < count; j++) {
+                    base[j] = (base[j][half - 1] < query[j]) ? base[j] + half : base[j];
+                }
+            }
+            for (size_t j = 0; j < count; j++) {
+                size_t pos = base[j] - keys + (*base[j] < query[j]);
+                movieIds[first + j] = (pos < n && keys[pos] == query[j]) ? map.values[pos] : -1;
+            }
+        }
+    }
+};
+
+#endif //LINKINDEX_H
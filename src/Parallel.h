@@ -0,0 +1,151 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+
+using namespace std;
+
+// Fixed set of worker threads shared by load-time passes and query kernels.
+// MOVIEREC_THREADS overrides the total thread count (workers + caller).
+class ThreadPool {
+private:
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex queueMutex;
+    condition_variable queueCv;
+    bool stopping = false;
+
+    void workerLoop() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(queueMutex);
+                queueCv.wait(lock, [&] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t numWorkers) {
+        for (size_t i = 0; i < numWorkers; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCv.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            tasks.push_back(std::move(task));
+        }
+        queueCv.notify_one();
+    }
+
+    // Run one queued task on the calling thread; false if the queue was empty
+    bool runPending() {
+        function<void()> task;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if (tasks.empty()) return false;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+
+    static ThreadPool& shared() {
+        static ThreadPool pool(defaultWorkers());
+        return pool;
+    }
+
+    // Threads a caller can use: the pool's workers plus itself
+    static size_t concurrency() { return shared().size() + 1; }
+
+private:
+    static size_t defaultWorkers() {
+        size_t threads = max<size_t>(1, thread::hardware_concurrency());
+        if (const char* env = getenv("MOVIEREC_THREADS")) {
+            int requested = atoi(env);
+            if (requested > 0) threads = requested;
+        }
+        return threads - 1;
+    }
+};
+
+// Split [0, n) into `chunks` contiguous pieces and run body(chunk, begin, end)
+// for each on the shared pool. Chunk 0 runs on the calling thread, which also
+// helps drain the queue while it waits, so nested calls cannot deadlock.
+template <typename F>
+void parallelChunks(size_t n, size_t chunks, F&& body) {
+    chunks = max<size_t>(1, min(chunks, n));
+    if (chunks <= 1) {
+        body(static_cast<size_t>(0), static_cast<size_t>(0), n);
+        return;
+    }
+
+    ThreadPool& pool = ThreadPool::shared();
+    size_t chunkSize = (n + chunks - 1) / chunks;
+    chunks = (n + chunkSize - 1) / chunkSize; // drop empty trailing chunks
+    size_t remaining = chunks - 1;
+    mutex doneMutex;
+    condition_variable doneCv;
+
+    for (size_t c = 1; c < chunks; c++) {
+        size_t begin = c * chunkSize;
+        size_t end = min(n, begin + chunkSize);
+        pool.submit([&, c, begin, end] {
+            body(c, begin, end);
+            lock_guard<mutex> lock(doneMutex);
+            if (--remaining == 0) doneCv.notify_all();
+        });
+    }
+
+    body(static_cast<size_t>(0), static_cast<size_t>(0), min(n, chunkSize));
+
+    while (true) {
+        {
+            lock_guard<mutex> lock(doneMutex);
+            if (remaining == 0) return;
+        }
+        if (!pool.runPending()) {
+            unique_lock<mutex> lock(doneMutex);
+            doneCv.wait(lock, [&] { return remaining == 0; });
+            return;
+        }
+    }
+}
+
+// Run body(begin, end) over [0, n), one chunk per available thread.
+// Small ranges run inline on the calling thread.
+template <typename F>
+void parallelFor(size_t n, F&& body, size_t minChunk = 4096) {
+    size_t chunks = min(ThreadPool::concurrency(), (n + minChunk - 1) / max<size_t>(minChunk, 1));
+    parallelChunks(n, chunks, [&](size_t, size_t begin, size_t end) { body(begin, end); });
+}
+
+#endif //PARALLEL_H
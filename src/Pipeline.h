@@ -0,0 +1,61 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <utility>
+#include <cstddef>
+
+using namespace std;
+
+// Bounded blocking queue between load pipeline stages. A full queue blocks
+// push(), which is the backpressure between stages, and an empty one blocks
+// pop(); both wait on a condition variable, so an idle stage sleeps instead
+// of spinning. Stages hand over whole chunks and batches, so the lock is
+// taken a few thousand times per second at most. Several producers may share
+// a queue: it counts as closed once each of them has called close().
+template <typename T>
+class BoundedQueue {
+private:
+    mutex lock;
+    condition_variable notEmpty;
+    condition_variable notFull;
+    deque<T> items;
+    size_t capacity;
+    size_t openProducers;
+
+public:
+    explicit BoundedQueue(size_t capacity, size_t producers = 1)
+        : capacity(capacity > 0 ? capacity : 1), openProducers(producers) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    void push(T item) {
+        unique_lock<mutex> guard(lock);
+        notFull.wait(guard, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        guard.unlock();
+        notEmpty.notify_one();
+    }
+
+    // Blocks until an item arrives; false once every producer closed an empty queue
+    bool pop(T& out) {
+        unique_lock<mutex> guard(lock);
+        notEmpty.wait(guard, [&] { return !items.empty() || openProducers == 0; });
+        if (items.empty()) return false;
+        out = std::move(items.front());
+        items.pop_front();
+        guard.unlock();
+        notFull.notify_one();
+        return true;
+    }
+
+    // Producer side: this producer will push no more items
+    void close() {
+        lock_guard<mutex> guard(lock);
+        if (openProducers > 0 && --openProducers == 0) notEmpty.notify_all();
+    }
+};
+
+#endif //PIPELINE_H
@@ -6,7 +6,7 @@
 #include <string>
 #include <utility>
 #include <vector>
-#include <unordered_map>
+#include <climits>
 
 using namespace std;
 
@@ -18,26 +18,18 @@ struct Movie {
     int movieId;
     string title;
     vector<string> genres;
-    unordered_map<int, float> userRatings; // userId -> rating
 
     Movie(int id = 0, string t = "") : movieId(id), title(std::move(t)) {}
 };
 
-// User structure to store user preferences
-struct User {
-    int userId;
-    unordered_map<int, float> movieRatings; // movieId -> rating
-
-    User(int id = 0) : userId(id) {}
-};
-
 // Node structure for Red-Black Tree
 struct MovieNode {
     Movie movie;
     Color color;
+    int size; // nodes in this subtree (0 for NIL), kept for rank/select
     MovieNode *left, *right, *parent;
 
-    MovieNode(Movie m) : movie(std::move(m)), color(RED), left(nullptr), right(nullptr), parent(nullptr) {}
+    MovieNode(Movie m) : movie(std::move(m)), color(RED), size(1), left(nullptr), right(nullptr), parent(nullptr) {}
 };
 
 // Red-Black Tree class for storing movies
@@ -55,6 +47,37 @@ public:
     std::vector<Movie> inOrder();
     void remove(int movieId);
 
+    // Order statistics, all O(log n) using subtree sizes
+    int size() const;
+    MovieNode* select(int k);               // k-th smallest (0-based), NIL if out of range
+    int rank(int movieId);                  // number of movies with id < movieId
+    int count(int lowId, int highId);       // number of movies with id in [lowId, highId]
+
+    // Lazy in-order iteration over ids in [lowId, highId]; each step is a successor walk
+    class RangeIterator {
+        MovieNode *node, *nil;
+        int highId;
+    public:
+        RangeIterator(MovieNode *n, MovieNode *nilNode, int high) : node(n), nil(nilNode), highId(high) {
+            if (node != nil && node->movie.movieId > highId) node = nil;
+        }
+        MovieNode* operator*() const { return node; }
+        RangeIterator& operator++() {
+            node = successor(node, nil);
+            if (node != nil && node->movie.movieId > highId) node = nil;
+            return *this;
+        }
+        bool operator!=(const RangeIterator& other) const { return node != other.node; }
+    };
+
+    struct Range {
+        RangeIterator first, last;
+        RangeIterator begin() const { return first; }
+        RangeIterator end() const { return last; }
+    };
+
+    Range range(int lowId = INT_MIN, int highId = INT_MAX);
+
 private:
     // and also declare these helpers:
     void deleteTree(MovieNode *node);
@@ -67,6 +90,8 @@ private:
     void transplant(MovieNode *u, MovieNode *v);
     void fixDelete(MovieNode *x);
     void deleteNodeHelper(MovieNode *node, int movieId);
+    MovieNode* lowerBound(int movieId);
+    static MovieNode* successor(MovieNode *node, MovieNode *nil);
 };
 
 
@@ -74,6 +99,7 @@ private:
 MovieRBTree::MovieRBTree() {
     NIL = new MovieNode(Movie());
     NIL->color = BLACK;
+    NIL->size = 0;
     NIL->left = nullptr;
     NIL->right = nullptr;
     root = NIL;
@@ -115,6 +141,9 @@ void MovieRBTree::rotateLeft(MovieNode *x) {
 
     y->left = x;
     x->parent = y;
+
+    y->size = x->size;
+    x->size = x->left->size + x->right->size + 1;
 }
 
 // Right rotation
@@ -138,6 +167,9 @@ void MovieRBTree::rotateRight(MovieNode *x) {
 
     y->right = x;
     x->parent = y;
+
+    y->size = x->size;
+    x->size = x->left->size + x->right->size + 1;
 }
 
 // Fix Red-Black Tree properties after insertion
@@ -195,6 +227,7 @@ void MovieRBTree::insert(const Movie& movie) {
 
     while (x != NIL) {
         y = x;
+        x->size++; // the new node lands somewhere below x
         if (node->movie.movieId < x->movie.movieId) {
             x = x->left;
         } else {
@@ -356,6 +389,12 @@ void MovieRBTree::deleteNodeHelper(MovieNode *node, int movieId) {
         return;
     }
 
+    // Every ancestor of the node that physically leaves its position loses one descendant
+    MovieNode *removed = (z->left == NIL || z->right == NIL) ? z : minimum(z->right);
+    for (MovieNode *p = removed->parent; p != nullptr; p = p->parent) {
+        p->size--;
+    }
+
     y = z;
     Color y_original_color = y->color;
 
@@ -382,6 +421,7 @@ void MovieRBTree::deleteNodeHelper(MovieNode *node, int movieId) {
         y->left = z->left;
         y->left->parent = y;
         y->color = z->color;
+        y->size = z->size;
     }
 
     delete z;
@@ -394,6 +434,94 @@ void MovieRBTree::deleteNodeHelper(MovieNode *node, int movieId) {
 // Remove a movie by ID
 void MovieRBTree::remove(int movieId) {
     deleteNodeHelper(root, movieId);
-};
+}
+
+// Number of movies in the tree
+int MovieRBTree::size() const {
+    return root->size;
+}
+
+// Select the k-th smallest movie (0-based) by descending on subtree sizes
+MovieNode* MovieRBTree::select(int k) {
+    if (k < 0 || k >= root->size) {
+        return NIL;
+    }
+
+    MovieNode *node = root;
+    while (node != NIL) {
+        int leftSize = node->left->size;
+        if (k < leftSize) {
+            node = node->left;
+        } else if (k == leftSize) {
+            return node;
+        } else {
+            k -= leftSize + 1;
+            node = node->right;
+        }
+    }
+    return NIL;
+}
+
+// Count movies with id strictly less than movieId
+int MovieRBTree::rank(int movieId) {
+    int r = 0;
+    MovieNode *node = root;
+    while (node != NIL) {
+        if (node->movie.movieId < movieId) {
+            r += node->left->size + 1;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return r;
+}
+
+// Count movies with id in [lowId, highId]
+int MovieRBTree::count(int lowId, int highId) {
+    if (lowId > highId) {
+        return 0;
+    }
+    int upper = (highId == INT_MAX) ? root->size : rank(highId + 1);
+    return upper - rank(lowId);
+}
+
+// First node with id >= movieId, or NIL
+MovieNode* MovieRBTree::lowerBound(int movieId) {
+    MovieNode *best = NIL;
+    MovieNode *node = root;
+    while (node != NIL) {
+        if (node->movie.movieId >= movieId) {
+            best = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return best;
+}
+
+// In-order successor using parent links, or NIL at the end
+MovieNode* MovieRBTree::successor(MovieNode *node, MovieNode *nil) {
+    if (node->right != nil) {
+        node = node->right;
+        while (node->left != nil) {
+            node = node->left;
+        }
+        return node;
+    }
+
+    MovieNode *p = node->parent;
+    while (p != nullptr && node == p->right) {
+        node = p;
+        p = p->parent;
+    }
+    return p == nullptr ? nil : p;
+}
+
+// Lazy iteration over ids in [lowId, highId]
+MovieRBTree::Range MovieRBTree::range(int lowId, int highId) {
+    return {RangeIterator(lowerBound(lowId), NIL, highId), RangeIterator(NIL, NIL, highId)};
+}
 
 #endif //RBTREE_H
\ No newline at end of file
@@ -0,0 +1,405 @@
+#ifndef RATINGSTORE_H
+#define RATINGSTORE_H
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "DenseStorage.h"
+
+using namespace std;
+
+// Out-of-core rating rows for data sets that do not fit in memory.
+// One file per orientation (user-major or movie-major), laid out as
+//   header | row offsets (uint64, rows + 1) | index column | value column
+// with both columns page-aligned and split into fixed blocks of
+// BLOCK_ENTRIES ratings. Only the row offsets stay resident; queries page
+// blocks in through a bounded LRU cache, so memory follows the budget, not
+// the file size.
+struct RatingStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockEntries;
+    uint64_t rows;
+    uint64_t nonZeros;     // ratings kept after duplicate removal
+    uint64_t capacity;     // column length reserved on disk
+    uint64_t offsetsPos;
+    uint64_t indexPos;
+    uint64_t valuesPos;
+};
+
+constexpr char RATING_STORE_MAGIC[8] = {'M', 'R', 'S', 'T', 'O', 'R', 'E', '1'};
+constexpr uint32_t RATING_STORE_BLOCK_ENTRIES = 4096; // 16 KiB per column block
+constexpr uint64_t RATING_STORE_ALIGN = 4096;
+
+inline uint64_t alignStorePos(uint64_t pos) {
+    return (pos + RATING_STORE_ALIGN - 1) / RATING_STORE_ALIGN * RATING_STORE_ALIGN;
+}
+
+// Writes one orientation of a store in two passes over the input: the caller
+// counts ratings per row first, then scatters every (row, col, value) with add().
+// finish() sorts each row by column, keeps the last value for a repeated
+// column (like RatingMatrix::build) and fills in the row aggregates.
+// Ratings reach the file through a write buffer of at most bufferBytes, and
+// finish() works through the rows in buffer-sized batches, so loading stays
+// within the memory budget however large the file is.
+class RatingStoreWriter {
+private:
+    struct Pending {
+        uint64_t pos;
+        int32_t col;
+        float value;
+    };
+
+    string path;
+    int fd = -1;
+    bool ok = true;
+    RatingStoreHeader header{};
+    vector<uint64_t> offsets; // rows + 1, written out by finish()
+    vector<uint64_t> fill;
+    vector<Pending> pending;
+    size_t maxPending = 1;
+
+    bool writeAt(uint64_t pos, const void* data, size_t bytes) {
+        const char* from = static_cast<const char*>(data);
+        while (bytes > 0) {
+            ssize_t written = ::pwrite(fd, from, bytes, static_cast<off_t>(pos));
+            if (written <= 0) return false;
+            from += written;
+            pos += written;
+            bytes -= written;
+        }
+        return true;
+    }
+
+    bool readAt(uint64_t pos, void* data, size_t bytes) {
+        char* to = static_cast<char*>(data);
+        while (bytes > 0) {
+            ssize_t got = ::pread(fd, to, bytes, static_cast<off_t>(pos));
+            if (got <= 0) return false;
+            to += got;
+            pos += got;
+            bytes -= got;
+        }
+        return true;
+    }
+
+    // Write buffered ratings in file order, one pwrite per contiguous run and column
+    void flush() {
+        sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) { return a.pos < b.pos; });
+        vector<int32_t> runIndex;
+        vector<float> runValues;
+        for (size_t i = 0; i < pending.size() && ok;) {
+            size_t j = i + 1;
+            while (j < pending.size() && pending[j].pos == pending[j - 1].pos + 1) j++;
+            runIndex.clear();
+            runValues.clear();
+            for (size_t k = i; k < j; k++) {
+                runIndex.push_back(pending[k].col);
+                runValues.push_back(pending[k].value);
+            }
+            uint64_t pos = pending[i].pos;
+            ok = writeAt(header.indexPos + pos * sizeof(int32_t), runIndex.data(), runIndex.size() * sizeof(int32_t))
+                 && writeAt(header.valuesPos + pos * sizeof(float), runValues.data(), runValues.size() * sizeof(float));
+            i = j;
+        }
+        pending.clear();
+    }
+
+public:
+    RatingStoreWriter() = default;
+    RatingStoreWriter(const RatingStoreWriter&) = delete;
+    RatingStoreWriter& operator=(const RatingStoreWriter&) = delete;
+    ~RatingStoreWriter() { close(); }
+
+    // Create the file with room for sum(rowCounts) ratings
+    bool create(const string& file, const vector<uint64_t>& rowCounts, size_t bufferBytes) {
+        path = file;
+        uint64_t capacity = 0;
+        for (uint64_t count : rowCounts) capacity += count;
+
+        memcpy(header.magic, RATING_STORE_MAGIC, sizeof(header.magic));
+        header.version = 1;
+        header.blockEntries = RATING_STORE_BLOCK_ENTRIES;
+        header.rows = rowCounts.size();
+        header.capacity = capacity;
+        header.offsetsPos = sizeof(RatingStoreHeader);
+        header.indexPos = alignStorePos(header.offsetsPos + (header.rows + 1) * sizeof(uint64_t));
+        header.valuesPos = alignStorePos(header.indexPos + capacity * sizeof(int32_t));
+        uint64_t fileBytes = alignStorePos(header.valuesPos + capacity * sizeof(float));
+
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(fileBytes)) != 0) return false;
+
+        offsets.assign(header.rows + 1, 0);
+        for (size_t r = 0; r < rowCounts.size(); r++) offsets[r + 1] = offsets[r] + rowCounts[r];
+        fill.assign(offsets.begin(), offsets.end() - 1);
+
+        // Each buffered rating also needs room for its run copy in flush()
+        maxPending = max<size_t>(1, bufferBytes / (sizeof(Pending) + sizeof(int32_t) + sizeof(float)));
+        pending.reserve(min<uint64_t>(maxPending, capacity));
+        ok = true;
+        return true;
+    }
+
+    void add(int row, int col, float value) {
+        if (pending.size() >= maxPending) flush();
+        pending.push_back({fill[row]++, col, value});
+    }
+
+    // Sort and compact every row in place, then write the offsets and header
+    bool finish(RatingAggregates& stats) {
+        flush();
+        vector<Pending>().swap(pending);
+        stats.assign(header.rows);
+
+        // Whole rows are read in batches of up to maxPending ratings (a longer
+        // row is read on its own). Compacted rows are written back at cursor,
+        // which never passes the start of the batch, so unread rows are safe.
+        vector<int32_t> idx;
+        vector<float> val;
+        vector<pair<int32_t, float>> row;
+        uint64_t cursor = 0;
+        for (uint64_t r = 0; r < header.rows && ok;) {
+            uint64_t first = r;
+            uint64_t begin = offsets[r];
+            r++;
+            while (r < header.rows && offsets[r + 1] - begin <= maxPending) r++;
+            uint64_t end = offsets[r];
+
+            size_t n = end - begin;
+            idx.resize(n);
+            val.resize(n);
+            ok = readAt(header.indexPos + begin * sizeof(int32_t), idx.data(), n * sizeof(int32_t))
+                 && readAt(header.valuesPos + begin * sizeof(float), val.data(), n * sizeof(float));
+
+            size_t out = 0;
+            for (uint64_t q = first; q < r; q++) {
+                uint64_t rowBegin = offsets[q] - begin, rowEnd = offsets[q + 1] - begin;
+                row.clear();
+                for (uint64_t j = rowBegin; j < rowEnd; j++) row.push_back({idx[j], val[j]});
+                stable_sort(row.begin(), row.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+                offsets[q] = cursor + out;
+                double sum = 0, sumSquares = 0;
+                uint32_t kept = 0;
+                for (size_t j = 0; j < row.size(); j++) {
+                    if (j + 1 < row.size() && row[j + 1].first == row[j].first) continue;
+                    idx[out] = row[j].first;
+                    val[out] = row[j].second;
+                    out++;
+                    sum += row[j].second;
+                    sumSquares += static_cast<double>(row[j].second) * row[j].second;
+                    kept++;
+                }
+                stats.setRow(q, kept, sum, sumSquares);
+            }
+
+            ok = ok && writeAt(header.indexPos + cursor * sizeof(int32_t), idx.data(), out * sizeof(int32_t))
+                 && writeAt(header.valuesPos + cursor * sizeof(float), val.data(), out * sizeof(float));
+            cursor += out;
+        }
+        offsets[header.rows] = cursor;
+        header.nonZeros = cursor;
+
+        ok = ok && writeAt(header.offsetsPos, offsets.data(), offsets.size() * sizeof(uint64_t))
+             && writeAt(0, &header, sizeof(header)) && fsync(fd) == 0;
+        bool written = ok;
+        close();
+        return written;
+    }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        offsets.clear();
+        offsets.shrink_to_fit();
+        fill.clear();
+        fill.shrink_to_fit();
+        vector<Pending>().swap(pending);
+    }
+};
+
+// Cache counters; bytesRead counts column bytes paged in from the file
+struct RatingStoreStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t bytesRead = 0;
+    size_t residentBytes = 0;
+    size_t budgetBytes = 0;
+    size_t fileBytes = 0;
+
+    double hitRate() const { return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / (hits + misses); }
+};
+
+// Read side of a store: mmap'd file plus an LRU cache of decoded blocks.
+// Safe to read from several threads; blocks handed out stay valid while in use
+// even if the cache evicts them.
+class RatingStore {
+private:
+    struct Block {
+        vector<int> index;
+        vector<float> values;
+    };
+    using BlockPtr = shared_ptr<const Block>;
+
+    int fd = -1;
+    const char* base = nullptr;
+    size_t mappedBytes = 0;
+    RatingStoreHeader header{};
+    vector<uint64_t> offsets;
+
+    // LRU: most recent at the front
+    mutable mutex cacheMutex;
+    mutable list<uint64_t> lru;
+    mutable unordered_map<uint64_t, pair<BlockPtr, list<uint64_t>::iterator>> cache;
+    size_t maxBlocks = 1;
+    mutable RatingStoreStats counters;
+
+    static constexpr size_t BLOCK_BYTES = RATING_STORE_BLOCK_ENTRIES * (sizeof(int32_t) + sizeof(float));
+
+    // Copy one block out of the mapping, then drop those pages so the
+    // mapping itself never holds more than the block being read
+    BlockPtr readBlock(uint64_t block) const {
+        uint64_t begin = block * header.blockEntries;
+        uint64_t count = min<uint64_t>(header.blockEntries, header.nonZeros - begin);
+        auto loaded = make_shared<Block>();
+        const char* indexPtr = base + header.indexPos + begin * sizeof(int32_t);
+        const char* valuesPtr = base + header.valuesPos + begin * sizeof(float);
+        loaded->index.assign(reinterpret_cast<const int32_t*>(indexPtr),
+                             reinterpret_cast<const int32_t*>(indexPtr) + count);
+        loaded->values.assign(reinterpret_cast<const float*>(valuesPtr),
+                              reinterpret_cast<const float*>(valuesPtr) + count);
+        madvise(const_cast<char*>(indexPtr), count * sizeof(int32_t), MADV_DONTNEED);
+        madvise(const_cast<char*>(valuesPtr), count * sizeof(float), MADV_DONTNEED);
+        return loaded;
+    }
+
+    BlockPtr fetch(uint64_t block) const {
+        {
+            lock_guard<mutex> lock(cacheMutex);
+            auto it = cache.find(block);
+            if (it != cache.end()) {
+                counters.hits++;
+                lru.splice(lru.begin(), lru, it->second.second);
+                return it->second.first;
+            }
+            counters.misses++;
+        }
+
+        // Read without the lock so hits on other threads never wait on disk
+        BlockPtr loaded = readBlock(block);
+
+        lock_guard<mutex> lock(cacheMutex);
+        counters.bytesRead += loaded->index.size() * (sizeof(int32_t) + sizeof(float));
+        auto it = cache.find(block);
+        if (it != cache.end()) {
+            // Another thread read the same block meanwhile; keep one copy cached
+            lru.splice(lru.begin(), lru, it->second.second);
+            return it->second.first;
+        }
+        while (cache.size() >= maxBlocks) {
+            cache.erase(lru.back());
+            lru.pop_back();
+            counters.evictions++;
+        }
+        lru.push_front(block);
+        cache.emplace(block, make_pair(loaded, lru.begin()));
+        return loaded;
+    }
+
+public:
+    RatingStore() = default;
+    RatingStore(const RatingStore&) = delete;
+    RatingStore& operator=(const RatingStore&) = delete;
+    ~RatingStore() { close(); }
+
+    // Map a store written by RatingStoreWriter; the cache holds at most budgetBytes of blocks
+    bool open(const string& path, size_t budgetBytes) {
+        close();
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(RatingStoreHeader)) return false;
+        mappedBytes = st.st_size;
+        void* mapped = mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) return false;
+        base = static_cast<const char*>(mapped);
+
+        memcpy(&header, base, sizeof(header));
+        if (memcmp(header.magic, RATING_STORE_MAGIC, sizeof(header.magic)) != 0) {
+            close();
+            return false;
+        }
+        const uint64_t* off = reinterpret_cast<const uint64_t*>(base + header.offsetsPos);
+        offsets.assign(off, off + header.rows + 1);
+        madvise(const_cast<char*>(base), header.indexPos, MADV_DONTNEED);
+
+        // Blocks are read in random order; tell the kernel not to read ahead
+        madvise(const_cast<char*>(base), mappedBytes, MADV_RANDOM);
+
+        maxBlocks = max<size_t>(1, budgetBytes / BLOCK_BYTES);
+        counters = RatingStoreStats();
+        counters.budgetBytes = budgetBytes;
+        counters.fileBytes = mappedBytes;
+        return true;
+    }
+
+    void close() {
+        lock_guard<mutex> lock(cacheMutex);
+        cache.clear();
+        lru.clear();
+        if (base) munmap(const_cast<char*>(base), mappedBytes);
+        if (fd >= 0) ::close(fd);
+        base = nullptr;
+        fd = -1;
+        offsets.clear();
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    size_t rows() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t nonZeros() const { return header.nonZeros; }
+
+    // f(col, value) for every rating in the row, columns ascending
+    template <typename F>
+    void forEachInRow(int row, F&& f) const {
+        uint64_t pos = offsets[row], end = offsets[row + 1];
+        while (pos < end) {
+            uint64_t block = pos / header.blockEntries;
+            uint64_t blockBegin = block * header.blockEntries;
+            BlockPtr data = fetch(block);
+            uint64_t stop = min(end, blockBegin + header.blockEntries);
+            for (; pos < stop; pos++) f(data->index[pos - blockBegin], data->values[pos - blockBegin]);
+        }
+    }
+
+    // The k-th rating of a row as (col, value)
+    pair<int, float> entryAt(int row, uint32_t k) const {
+        uint64_t pos = offsets[row] + k;
+        BlockPtr data = fetch(pos / header.blockEntries);
+        uint64_t at = pos % header.blockEntries;
+        return {data->index[at], data->values[at]};
+    }
+
+    RatingStoreStats stats() const {
+        lock_guard<mutex> lock(cacheMutex);
+        RatingStoreStats s = counters;
+        for (const auto& entry : cache) {
+            s.residentBytes += entry.second.first->index.size() * (sizeof(int32_t) + sizeof(float));
+        }
+        s.residentBytes += offsets.size() * sizeof(uint64_t);
+        return s;
+    }
+};
+
+#endif //RATINGSTORE_H
@@ -0,0 +1,58 @@
+#ifndef RECOMMENDATION_H
+#define RECOMMENDATION_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+// One recommended movie: id, score and non-owning views into the catalog.
+// The views stay valid for as long as the movie stays in the movie tree.
+struct Recommendation {
+    int movieId;
+    float score;
+    string_view title;
+    const vector<string>* genres;
+    bool fromPopularity = false; // popularity row: score is a Bayesian average, not the query's score
+};
+
+// Writes "Title (<label>: score)"; popularity rows are labelled as such so they
+// are not read as the query's own score
+inline void printRecommendation(ostream& out, const Recommendation& rec, const string& label) {
+    out << rec.title << " (" << (rec.fromPopularity ? "Popular, Bayesian average" : label) << ": " << fixed
+        << setprecision(2) << rec.score << ")" << endl;
+}
+
+// Receives recommendations one at a time, best first, as a query emits them
+class RecommendationSink {
+public:
+    virtual ~RecommendationSink() = default;
+    virtual void accept(const Recommendation& rec) = 0;
+};
+
+// Collects results into a vector
+class VectorSink : public RecommendationSink {
+public:
+    vector<Recommendation> results;
+
+    void accept(const Recommendation& rec) override {
+        results.push_back(rec);
+    }
+};
+
+// Writes "Title (<label>: score)" lines straight to a stream
+class PrintSink : public RecommendationSink {
+    ostream& out;
+    string label;
+
+public:
+    PrintSink(ostream& os, string scoreLabel) : out(os), label(std::move(scoreLabel)) {}
+
+    void accept(const Recommendation& rec) override {
+        printRecommendation(out, rec, label);
+    }
+};
+
+#endif //RECOMMENDATION_H
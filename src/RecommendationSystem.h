@@ -8,37 +8,126 @@
 #include <iomanip>
 #include <algorithm>
 #include <chrono>
+#include <future>
+#include <mutex>
+#include <random>
 #include "Filtering.h"
+#include "TagIndex.h"
+#include "LinkIndex.h"
 
 
 using namespace std;
 
+// A recommendation expressed in upstream identifiers
+struct ExternalRecommendation {
+    int movieId;
+    ExternalIds ids;
+    float score;
+    bool fromPopularity;
+};
+
 class RecommendationSystem {
     CollaborativeFiltering cfSystem;
 
-    // Content-Based filtering still needs to be implemented | ContentBasedFiltering cbSystem
+    TagIndex tagIndex; // TF-IDF tag/genre vectors for content-based filtering
+    LinkIndex linkIndex; // movieId <-> IMDb/TMDB ids
 
     unordered_map<string, int> titleToId; // For title lookup
     unordered_map<int, string> idToTitle; // For reverse lookup
 
+    HybridWeights hybridWeights; // blend used by the hybrid recommender
+
+    // Ratings and the content/link indexes load in the background after initialize
+    shared_future<bool> ratingsLoaded;
+    shared_future<bool> contentLoaded;
+
+    // Status lines from the background loaders, printed by the foreground
+    mutex statusMutex;
+    string pendingStatus;
+
+    void postStatus(const string& text) {
+        lock_guard<mutex> lock(statusMutex);
+        pendingStatus += text;
+    }
+
 public:
-    bool initialize(const string& moviesFile, const string& ratingsFile) {
+    // Loads movies synchronously, so title lookup and catalog browsing work on
+    // return; ratings, tags and links keep loading on background threads.
+    // Anything that needs them waits via waitUntilLoaded(). Fails up front if
+    // the movies or the ratings file cannot be read.
+    bool initialize(const string& moviesFile, const string& ratingsFile, const string& tagsFile,
+                    const string& linksFile) {
         auto startTime = chrono::high_resolution_clock::now();
 
         // Parse movies file first to build title maps
-        if (!parseMoviesFile(moviesFile)) {
+        if (!parseMoviesFile(moviesFile) || !cfSystem.loadMovies(moviesFile)) {
+            return false;
+        }
+        if (!ifstream(ratingsFile).is_open()) {
+            cerr << "Error opening ratings file: " << ratingsFile << endl;
             return false;
         }
-
-        bool success = cfSystem.loadData(moviesFile, ratingsFile);
 
         auto endTime = chrono::high_resolution_clock::now();
-        auto duration = chrono::duration_cast<chrono::seconds>(endTime - startTime).count();
+        cout << "Loaded " << titleToId.size() << " movies in "
+             << chrono::duration_cast<chrono::milliseconds>(endTime - startTime).count()
+             << " ms; ratings, tags and links are loading in the background" << endl;
+
+        ratingsLoaded = async(launch::async, [this, ratingsFile] {
+            ostringstream log;
+            bool loaded = cfSystem.loadRatings(ratingsFile, log);
+            postStatus(log.str());
+            return loaded;
+        }).share();
+
+        // Build the content index: genres for every movie, plus tags when available
+        // (registered in slot order so filter bitmaps address tag documents directly)
+        contentLoaded = async(launch::async, [this, tagsFile, linksFile] {
+            cfSystem.forEachMovie([&](const Movie& movie) {
+                tagIndex.addMovie(movie.movieId, movie.genres);
+            });
+            parseTagsFile(tagsFile);
+            tagIndex.build();
+            ostringstream log;
+            log << "Indexed " << tagIndex.numTerms() << " content terms (" << tagIndex.numPostings() << " postings)"
+                << endl;
+
+            if (linkIndex.load(linksFile)) {
+                log << "Loaded external ids for " << linkIndex.size() << " movies" << endl;
+            }
+            postStatus(log.str());
+            return true;
+        }).share();
+
+        return true;
+    }
 
-        cout << "Data loading took " << duration << " seconds" << endl;
-        cout << "Loaded " << titleToId.size() << " movies" << endl;
+    // Block until the background load finishes; false if the ratings failed to load
+    bool waitUntilLoaded() {
+        if (!ratingsLoaded.valid()) return false;
+        if (ratingsLoaded.wait_for(chrono::seconds(0)) != future_status::ready
+            || contentLoaded.wait_for(chrono::seconds(0)) != future_status::ready) {
+            cout << "Waiting for ratings to finish loading..." << endl;
+        }
+        contentLoaded.wait();
+        ratingsLoaded.wait();
+        printLoadStatus();
+        if (!ratingsLoaded.get()) {
+            cout << "Ratings are unavailable" << endl;
+            return false;
+        }
+        return true;
+    }
 
-        return success;
+    // Print what the background loaders reported since the last call; the menu
+    // loop calls this between commands so status never splits other output
+    void printLoadStatus() {
+        string text;
+        {
+            lock_guard<mutex> lock(statusMutex);
+            text.swap(pendingStatus);
+        }
+        cout << text << flush;
     }
 
     // Function to parse CSV files and build the titleToId map
@@ -84,6 +173,28 @@ public:
         return true;
     }
 
+    // Feed tags.csv (userId,movieId,tag,timestamp) into the content index
+    bool parseTagsFile(const string& filename) {
+        ifstream file(filename);
+        if (!file.is_open()) {
+            cerr << "Tags file not found (" << filename << "), content filtering will use genres only" << endl;
+            return false;
+        }
+
+        string line;
+        // Skip header
+        getline(file, line);
+
+        while (getline(file, line)) {
+            vector<string> fields = cfSystem.parseCSVLine(line);
+            if (fields.size() >= 3) {
+                tagIndex.addTag(stoi(fields[1]), fields[2]);
+            }
+        }
+
+        return true;
+    }
+
     // Get movie recommendations based on a title
     void getRecommendationsByTitle(const string& title) {
         auto it = titleToId.find(title);
@@ -95,6 +206,7 @@ public:
         }
 
         int movieId = it->second;
+        if (!waitUntilLoaded()) return;
 
         // Get recommendations using collaborative filtering
         auto startTime = chrono::high_resolution_clock::now();
@@ -105,17 +217,158 @@ public:
         // Display recommendations
         cout << "\nCollaborative Filtering Recommendations for \"" << title << "\":" << endl;
         cout << "-----------------------------------------------------------------------------" << endl << endl;
-        for (const auto& [movie, score] : cfRecommendations) {
-            cout << movie.title << " (Score: " << fixed << setprecision(2) << score << ")" << endl;
+        for (const auto& rec : cfRecommendations) {
+            printRecommendation(cout, rec, "Score");
         }
         cout << "Time: " << cfTime << " ms" << endl;
 
-        // We'd add content-based filtering recommendations here as well
+        startTime = chrono::high_resolution_clock::now();
         auto cbRecs = getContentRecommendations(movieId);
+        endTime = chrono::high_resolution_clock::now();
+        auto cbTime = chrono::duration_cast<chrono::microseconds>(endTime - startTime).count();
+
         cout << "\nContent-Based Recommendations for \"" << title << "\":" << endl;
         cout << "-----------------------------------------------------------------------------" << endl << endl;
-        for (const auto& [movie, score] : cbRecs) {
-            cout << movie.title << " (Genre-Overlap Score: " << fixed << setprecision(2) << score << ")" << endl;
+        for (const auto& rec : cbRecs) {
+            cout << rec.title << " (Content Similarity: " << fixed << setprecision(2) << rec.score << ")" << endl;
+        }
+        cout << "Time: " << cbTime << " us" << endl;
+    }
+
+    // Collaborative filtering under a latency budget; prints the best-so-far answer
+    void getRecommendationsByTitle(const string& title, long long budgetMicros) {
+        auto it = titleToId.find(title);
+        if (it == titleToId.end()) {
+            cout << "Movie not found: " << title << endl;
+            suggestSimilarTitles(title);
+            return;
+        }
+        if (!waitUntilLoaded()) return;
+
+        auto startTime = chrono::high_resolution_clock::now();
+        auto result = cfSystem.getRecommendations(it->second, 5, chrono::microseconds(budgetMicros));
+        auto endTime = chrono::high_resolution_clock::now();
+        auto elapsed = chrono::duration_cast<chrono::microseconds>(endTime - startTime).count();
+
+        cout << "\nCollaborative Filtering Recommendations for \"" << title << "\""
+             << (result.exact ? " (exact):" : " (approximate, budget reached):") << endl;
+        cout << "-----------------------------------------------------------------------------" << endl << endl;
+        for (const auto& rec : result.recommendations) {
+            printRecommendation(cout, rec, "Score");
+        }
+        cout << "Time: " << elapsed << " us (budget " << budgetMicros << " us)" << endl;
+    }
+
+    // Both engines restricted to movies matching the filter
+    void getFilteredRecommendationsByTitle(const string& title, const MovieFilter& filter, int numRecs = 5) {
+        auto it = titleToId.find(title);
+        if (it == titleToId.end()) {
+            cout << "Movie not found: " << title << endl;
+            suggestSimilarTitles(title);
+            return;
+        }
+        if (!waitUntilLoaded()) return;
+
+        auto startTime = chrono::high_resolution_clock::now();
+        RoaringBitmap candidates = cfSystem.resolveFilter(filter);
+        auto endTime = chrono::high_resolution_clock::now();
+        cout << candidates.cardinality() << " movies match the filter ("
+             << chrono::duration_cast<chrono::microseconds>(endTime - startTime).count() << " us)" << endl;
+
+        cout << "\nFiltered Collaborative Filtering Recommendations for \"" << title << "\":" << endl;
+        cout << "-----------------------------------------------------------------------------" << endl << endl;
+        PrintSink printer(cout, "Score");
+        if (filter.empty()) {
+            cfSystem.getRecommendations(it->second, numRecs, printer);
+        } else {
+            cfSystem.getRecommendations(it->second, numRecs, candidates, printer);
+        }
+
+        startTime = chrono::high_resolution_clock::now();
+        auto cbRecs = tagIndex.topN(it->second, numRecs, filter.empty() ? nullptr : &candidates);
+        endTime = chrono::high_resolution_clock::now();
+        cout << "\nFiltered Content-Based Recommendations for \"" << title << "\":" << endl;
+        cout << "-----------------------------------------------------------------------------" << endl << endl;
+        for (const auto& [recMovieId, score] : cbRecs) {
+            cout << idToTitle[recMovieId] << " (Content Similarity: " << fixed << setprecision(2) << score << ")" << endl;
+        }
+        cout << "Time: " << chrono::duration_cast<chrono::microseconds>(endTime - startTime).count() << " us" << endl;
+    }
+
+    // One ranked list blending collaborative, content and popularity signals
+    void getHybridRecommendationsByTitle(const string& title, int numRecs = 5) {
+        auto it = titleToId.find(title);
+        if (it == titleToId.end()) {
+            cout << "Movie not found: " << title << endl;
+            suggestSimilarTitles(title);
+            return;
+        }
+        if (!waitUntilLoaded()) return;
+
+        ios::fmtflags flags = cout.flags();
+        streamsize precision = cout.precision();
+        cout << "\nHybrid Recommendations for \"" << title << "\" (collaborative " << fixed << setprecision(2) << hybridWeights.collaborative
+             << ", content " << hybridWeights.content << ", popularity " << hybridWeights.popularity << "):" << endl;
+        cout << "-----------------------------------------------------------------------------" << endl << endl;
+        auto startTime = chrono::high_resolution_clock::now();
+        PrintSink printer(cout, "Hybrid Score");
+        cfSystem.getHybridRecommendations(it->second, numRecs, tagIndex, hybridWeights, printer);
+        auto endTime = chrono::high_resolution_clock::now();
+        cout << "Time: " << chrono::duration_cast<chrono::microseconds>(endTime - startTime).count() << " us" << endl;
+        cout.flags(flags);
+        cout.precision(precision);
+    }
+
+    // Blend weights for the hybrid recommender (negative weights are clamped to 0)
+    void setHybridWeights(const HybridWeights& weights) {
+        hybridWeights.collaborative = max(weights.collaborative, 0.0f);
+        hybridWeights.content = max(weights.content, 0.0f);
+        hybridWeights.popularity = max(weights.popularity, 0.0f);
+    }
+
+    const HybridWeights& getHybridWeights() const { return hybridWeights; }
+
+    // Print the highest Bayesian-average movies
+    void listPopularMovies(int count = 10) {
+        if (!waitUntilLoaded()) return;
+        cout << "\nMost popular movies (Bayesian average rating):" << endl;
+        cout << "-----------------------------------------------------------------------------" << endl << endl;
+        PrintSink printer(cout, "Score");
+        cfSystem.getPopularMovies(count, MovieFilter(), printer);
+    }
+
+    // Collaborative filtering keyed by an IMDb/TMDB id; results carry external ids too
+    vector<ExternalRecommendation> getRecommendationsByExternalId(ExternalIdKind kind, int externalId,
+                                                                  int numRecs = 5) {
+        vector<ExternalRecommendation> recs;
+        if (!waitUntilLoaded()) return recs;
+        int movieId = linkIndex.toMovieId(kind, externalId);
+        if (movieId < 0) return recs;
+
+        for (const auto& rec : cfSystem.getRecommendations(movieId, numRecs)) {
+            recs.push_back({rec.movieId, linkIndex.toExternal(rec.movieId), rec.score, rec.fromPopularity});
+        }
+        return recs;
+    }
+
+    // Interactive wrapper for getRecommendationsByExternalId
+    void printRecommendationsByExternalId(ExternalIdKind kind, int externalId) {
+        if (!waitUntilLoaded()) return;
+        int movieId = linkIndex.toMovieId(kind, externalId);
+        auto titleIt = idToTitle.find(movieId);
+        if (movieId < 0 || titleIt == idToTitle.end()) {
+            cout << "No movie linked to " << (kind == ExternalIdKind::IMDB ? "IMDb" : "TMDB")
+                 << " id " << externalId << endl;
+            return;
+        }
+
+        auto recs = getRecommendationsByExternalId(kind, externalId);
+        cout << "\nCollaborative Filtering Recommendations for \"" << titleIt->second << "\":" << endl;
+        cout << "-----------------------------------------------------------------------------" << endl << endl;
+        for (const auto& rec : recs) {
+            cout << idToTitle[rec.movieId] << " [imdb " << rec.ids.imdbId << ", tmdb " << rec.ids.tmdbId
+                 << "] (" << (rec.fromPopularity ? "Popular, Bayesian average" : "Score") << ": " << fixed
+                 << setprecision(2) << rec.score << ")" << endl;
         }
     }
 
@@ -179,35 +432,13 @@ public:
         return 1.0f - (diff[len1][len2] / maxLen);
     }
 
-    vector<pair<Movie, float>> getContentRecommendations(int movieId, int numRecs = 5) {
-        // 1) Find the target movie node
-        MovieNode* target = cfSystem.getMovieNode(movieId);
-        if (!target) return {};
-
-        // 2) Build a max‑heap of (score, movieId)
-        struct Scored { float score; int id;
-            bool operator<(Scored const& o) const { return score < o.score; }
-        };
-        priority_queue<Scored> heap;
-
-        // 3) Compute simple genre‑overlap score for every other movie
-        auto allMovies = cfSystem.getAllMovies();
-        for (auto &m : allMovies) {
-            if (m.movieId == movieId) continue;
-            float score = 0;
-            for (auto &g1 : target->movie.genres)
-                for (auto &g2 : m.genres)
-                    if (g1 == g2) score += 1.0f;  // +1 per matching genre
-            heap.push({score, m.movieId});
-        }
-
-        // 4) Pop top numRecs and assemble results
-        vector<pair<Movie, float>> recs;
-        for (int i = 0; i < numRecs && !heap.empty(); ++i) {
-            auto top = heap.top(); heap.pop();
-            MovieNode* node = cfSystem.getMovieNode(top.id);
+    // Content-based recommendations: top-N cosine similarity over TF-IDF tag/genre vectors
+    vector<Recommendation> getContentRecommendations(int movieId, int numRecs = 5) {
+        vector<Recommendation> recs;
+        for (const auto& [recMovieId, score] : tagIndex.topN(movieId, numRecs)) {
+            MovieNode* node = cfSystem.getMovieNode(recMovieId);
             if (node)
-                recs.emplace_back( node->movie, top.score );
+                recs.push_back({recMovieId, score, node->movie.title, &node->movie.genres});
         }
         return recs;
     }
@@ -248,6 +479,8 @@ public:
                 if (i + 1 < node->movie.genres.size()) cout << ", ";
             }
             cout << endl;
+            cout << "Rank " << cfSystem.getMovieRank(id) + 1 << " of " << cfSystem.getMovieCount()
+                 << " by id" << endl;
         } else {
             cout << "Movie not found." << endl;
         }
@@ -255,10 +488,112 @@ public:
         cout << "Search took " << elapsed_us << " us" << endl;
     }
 
+    // Print one page of the catalog in id order
+    void listCatalogPage(int page, int pageSize = 20) {
+        int total = cfSystem.getMovieCount();
+        int pages = (total + pageSize - 1) / pageSize;
+        if (page < 1 || page > pages) {
+            cout << "Page must be between 1 and " << pages << endl;
+            return;
+        }
+
+        auto start = chrono::high_resolution_clock::now();
+        auto nodes = cfSystem.getCatalogPage((page - 1) * pageSize, pageSize);
+        auto elapsed_us = chrono::duration_cast<chrono::microseconds>(
+                chrono::high_resolution_clock::now() - start
+        ).count();
+
+        cout << "\nCatalog page " << page << " of " << pages << ":" << endl;
+        for (MovieNode* node : nodes) {
+            cout << "  " << node->movie.movieId << " - " << node->movie.title << endl;
+        }
+        cout << "Page lookup took " << elapsed_us << " us" << endl;
+    }
+
+    // Choose the similarity metric used by collaborative filtering
+    void setSimilarityMetric(SimilarityMetric metric) {
+        cfSystem.setSimilarityMetric(metric);
+        cout << "Similarity metric: " << similarityMetricName(metric) << endl;
+    }
+
+    // Keep ratings on disk with a block cache of at most budgetBytes (before initialize)
+    void enableOutOfCore(size_t budgetBytes) {
+        cfSystem.enableOutOfCore(budgetBytes);
+    }
+
+    // Average and p99 latency of the current metric over random movies
+    CollaborativeFiltering::MetricReport measureQueryLatency(int numQueries = 100) {
+        if (!waitUntilLoaded()) return {};
+        return cfSystem.benchmarkMetric(cfSystem.getSimilarityMetric(), cfSystem.getRandomMovieIds(numQueries));
+    }
+
     // Run performance benchmark
     void runPerformanceBenchmark() {
+        if (!waitUntilLoaded()) return;
         cout << "\nRunning performance benchmark..." << endl;
         cfSystem.analyzePerformance();
+        compareExternalIdLookups();
+        compareHybridCost();
+    }
+
+    // IMDb id -> movieId throughput: one search per id against LinkIndex::resolveBatch
+    void compareExternalIdLookups(int rounds = 20) {
+        vector<int> imdbIds;
+        for (int movieId : cfSystem.getAllMovieIds()) {
+            int imdbId = linkIndex.toExternal(movieId).imdbId;
+            if (imdbId >= 0) imdbIds.push_back(imdbId);
+        }
+        if (imdbIds.empty()) return;
+        mt19937 gen(42);
+        shuffle(imdbIds.begin(), imdbIds.end(), gen);
+
+        vector<int> single(imdbIds.size()), batch;
+        auto startTime = chrono::high_resolution_clock::now();
+        for (int r = 0; r < rounds; r++) {
+            for (size_t i = 0; i < imdbIds.size(); i++) single[i] = linkIndex.toMovieId(ExternalIdKind::IMDB, imdbIds[i]);
+        }
+        auto singleEnd = chrono::high_resolution_clock::now();
+        for (int r = 0; r < rounds; r++) linkIndex.resolveBatch(ExternalIdKind::IMDB, imdbIds, batch);
+        auto batchEnd = chrono::high_resolution_clock::now();
+
+        double lookups = static_cast<double>(imdbIds.size()) * rounds;
+        double singleRate = lookups / chrono::duration<double>(singleEnd - startTime).count();
+        double batchRate = lookups / chrono::duration<double>(batchEnd - singleEnd).count();
+        ios::fmtflags flags = cout.flags();
+        streamsize precision = cout.precision();
+        cout << "\nExternal id lookups (" << imdbIds.size() << " IMDb ids): " << fixed << setprecision(1)
+             << singleRate / 1e6 << " M/s one at a time, " << batchRate / 1e6 << " M/s batched"
+             << (single == batch ? "" : " (results differ!)") << endl;
+        cout.flags(flags);
+        cout.precision(precision);
+    }
+
+    // Fused hybrid query against running both engines back to back
+    void compareHybridCost(int numQueries = 100) {
+        vector<int> movieIds = cfSystem.getRandomMovieIds(numQueries);
+        if (movieIds.empty()) return;
+
+        auto startTime = chrono::high_resolution_clock::now();
+        for (int movieId : movieIds) {
+            VectorSink sink;
+            cfSystem.getRecommendations(movieId, 5, sink);
+            tagIndex.topN(movieId, 5);
+        }
+        auto separateEnd = chrono::high_resolution_clock::now();
+        for (int movieId : movieIds) {
+            VectorSink sink;
+            cfSystem.getHybridRecommendations(movieId, 5, tagIndex, hybridWeights, sink);
+        }
+        auto hybridEnd = chrono::high_resolution_clock::now();
+
+        double separate = chrono::duration<double, micro>(separateEnd - startTime).count() / movieIds.size();
+        double hybrid = chrono::duration<double, micro>(hybridEnd - separateEnd).count() / movieIds.size();
+        ios::fmtflags flags = cout.flags();
+        streamsize precision = cout.precision();
+        cout << "\nHybrid query (one ranked list): " << fixed << setprecision(1) << hybrid
+             << " us avg vs " << separate << " us for collaborative + content separately" << endl;
+        cout.flags(flags);
+        cout.precision(precision);
     }
 
 };
@@ -0,0 +1,120 @@
+#ifndef SCALINGBENCHMARK_H
+#define SCALINGBENCHMARK_H
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "DatasetGenerator.h"
+#include "RecommendationSystem.h"
+
+using namespace std;
+
+// One row of the scaling table, measured in a child process
+struct ScalingResult {
+    bool ok = false;
+    double scale = 0;
+    DatasetStats data;
+    double generateSeconds = 0;
+    double loadSeconds = 0;
+    double peakRssMb = 0;
+    double avgMicros = 0;
+    double p99Micros = 0;
+};
+
+// Generate, load and query one data set size (runs inside the child)
+inline ScalingResult measureScale(double scale, uint32_t seed, const string& dir, SimilarityMetric metric,
+                                  size_t memoryBudget, int queries) {
+    ScalingResult result;
+    result.scale = scale;
+    filesystem::create_directories(dir);
+
+    auto startTime = chrono::high_resolution_clock::now();
+    if (!generateDataset(DatasetConfig::scaled(scale, seed), dir, &result.data)) return result;
+    auto generated = chrono::high_resolution_clock::now();
+    result.generateSeconds = chrono::duration<double>(generated - startTime).count();
+
+    RecommendationSystem sys;
+    sys.enableOutOfCore(memoryBudget);
+    if (!sys.initialize(dir + "/movies.csv", dir + "/ratings.csv", dir + "/tags.csv", dir + "/links.csv")
+        || !sys.waitUntilLoaded()) {
+        return result;
+    }
+    result.loadSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - generated).count();
+
+    sys.setSimilarityMetric(metric);
+    auto report = sys.measureQueryLatency(queries);
+    result.avgMicros = report.avgMicros;
+    result.p99Micros = report.p99Micros;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peakRssMb = usage.ru_maxrss / 1024.0; // kilobytes on Linux
+    result.ok = true;
+    return result;
+}
+
+// Scaling curve: for each scale factor (1 = MovieLens latest-small), generate a
+// synthetic data set under baseDir and measure load time, peak RSS and query
+// latency. Each size runs in a fresh process so earlier sizes cannot inflate
+// the memory peak of later ones.
+inline void runScalingBenchmark(const vector<double>& scales, uint32_t seed, const string& baseDir,
+                                SimilarityMetric metric, size_t memoryBudget = 0, int queries = 100) {
+    cout << "Scaling benchmark (seed " << seed << ", metric " << similarityMetricName(metric)
+         << (memoryBudget > 0 ? ", out-of-core" : "") << ", " << queries << " queries per size)" << endl;
+    cout << right << setw(8) << "Scale" << setw(10) << "Movies" << setw(10) << "Users" << setw(12) << "Ratings"
+         << setw(10) << "Gen (s)" << setw(10) << "Load (s)" << setw(12) << "Peak (MB)" << setw(12) << "Avg (us)"
+         << setw(12) << "p99 (us)" << endl;
+
+    for (double scale : scales) {
+        ostringstream dir;
+        dir << baseDir << "/scale-" << scale;
+
+        int fds[2];
+        if (pipe(fds) != 0) {
+            cerr << "pipe failed" << endl;
+            return;
+        }
+        cout.flush();
+        pid_t pid = fork();
+        if (pid < 0) {
+            cerr << "fork failed" << endl;
+            return;
+        }
+        if (pid == 0) {
+            // Child: keep the loader's progress output out of the table
+            close(fds[0]);
+            int devNull = open("/dev/null", O_WRONLY);
+            if (devNull >= 0) dup2(devNull, STDOUT_FILENO);
+            ScalingResult result = measureScale(scale, seed, dir.str(), metric, memoryBudget, queries);
+            cout.flush();
+            ssize_t written = write(fds[1], &result, sizeof(result));
+            _exit(written == static_cast<ssize_t>(sizeof(result)) ? 0 : 1);
+        }
+
+        close(fds[1]);
+        ScalingResult result;
+        ssize_t got = read(fds[0], &result, sizeof(result));
+        close(fds[0]);
+        waitpid(pid, nullptr, 0);
+
+        cout << right << setw(8) << scale;
+        if (got != static_cast<ssize_t>(sizeof(result)) || !result.ok) {
+            cout << "  failed (see " << dir.str() << ")" << endl;
+            continue;
+        }
+        cout << setw(10) << result.data.movies << setw(10) << result.data.users << setw(12) << result.data.ratings
+             << fixed << setprecision(2) << setw(10) << result.generateSeconds << setw(10) << result.loadSeconds
+             << setprecision(1) << setw(12) << result.peakRssMb << setw(12) << result.avgMicros
+             << setw(12) << result.p99Micros << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+#endif //SCALINGBENCHMARK_H
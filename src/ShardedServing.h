@@ -0,0 +1,453 @@
+#ifndef SHARDEDSERVING_H
+#define SHARDEDSERVING_H
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "Filtering.h"
+
+using namespace std;
+
+// Multi-process serving on one host: users are partitioned by id across N
+// worker processes, each loading only its own users' ratings. A coordinator
+// holding just the movie catalog scatters every query to the workers over
+// Unix socket pairs and merges their partial profiles, top-k neighbour lists
+// and score sums (see the sharded serving hooks in CollaborativeFiltering).
+
+enum class ShardCommand : uint32_t {
+    PROFILE,        // -> ProfilePart[]
+    SCORE,          // ProfileMean[] -> SimilarUser[]
+    ACCUMULATE,     // SimilarUser[] -> ScorePart[]
+    AGGREGATES,     // -> MovieAggregate[] (this shard's ratings only)
+    SET_AGGREGATES, // MovieAggregate[] -> ack
+    SHUTDOWN
+};
+
+// Fixed-size frame header; `count` POD items of the command's type follow
+struct ShardHeader {
+    ShardCommand command;
+    uint32_t count;
+    int32_t movieId;
+    int32_t k;
+};
+
+struct MovieAggregate {
+    uint32_t count;
+    double sum;
+    double sumSquares;
+};
+
+// Blocking framed messages over one end of a socket pair
+class ShardChannel {
+private:
+    int fd = -1;
+
+    bool writeAll(const void* data, size_t bytes) const {
+        const char* p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            ssize_t n = ::send(fd, p, bytes, MSG_NOSIGNAL); // a dead peer is an error, not SIGPIPE
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            bytes -= n;
+        }
+        return true;
+    }
+
+    bool readAll(void* data, size_t bytes) const {
+        char* p = static_cast<char*>(data);
+        while (bytes > 0) {
+            ssize_t n = read(fd, p, bytes);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            bytes -= n;
+        }
+        return true;
+    }
+
+public:
+    ShardChannel() = default;
+    explicit ShardChannel(int fd) : fd(fd) {}
+
+    int descriptor() const { return fd; }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    template <typename T>
+    bool send(ShardCommand command, int movieId, int k, const vector<T>& items) const {
+        ShardHeader header{command, static_cast<uint32_t>(items.size()), movieId, k};
+        return writeAll(&header, sizeof(header)) && writeAll(items.data(), items.size() * sizeof(T));
+    }
+
+    bool send(ShardCommand command, int movieId = 0, int k = 0) const {
+        return send(command, movieId, k, vector<char>());
+    }
+
+    bool receiveHeader(ShardHeader& header) const { return readAll(&header, sizeof(header)); }
+
+    template <typename T>
+    bool receiveItems(const ShardHeader& header, vector<T>& items) const {
+        items.resize(header.count);
+        return readAll(items.data(), items.size() * sizeof(T));
+    }
+
+    // Header plus payload, for replies whose header carries nothing else
+    template <typename T>
+    bool receive(vector<T>& items) const {
+        ShardHeader header;
+        return receiveHeader(header) && receiveItems(header, items);
+    }
+};
+
+// Worker side: answer requests until SHUTDOWN or the coordinator goes away
+inline void serveShard(CollaborativeFiltering& cf, const ShardChannel& channel) {
+    using ProfileMean = CollaborativeFiltering::ProfileMean;
+    using SimilarUser = CollaborativeFiltering::SimilarUser;
+
+    ShardHeader request;
+    while (channel.receiveHeader(request)) {
+        bool ok = true;
+        switch (request.command) {
+            case ShardCommand::PROFILE:
+                ok = channel.send(request.command, request.movieId, 0, cf.partialProfile(request.movieId));
+                break;
+            case ShardCommand::SCORE: {
+                vector<ProfileMean> means;
+                ok = channel.receiveItems(request, means)
+                     && channel.send(request.command, request.movieId, 0,
+                                     cf.scoreShardRaters(request.movieId, means, request.k));
+                break;
+            }
+            case ShardCommand::ACCUMULATE: {
+                vector<SimilarUser> users;
+                ok = channel.receiveItems(request, users)
+                     && channel.send(request.command, request.movieId, 0, cf.partialScores(request.movieId, users));
+                break;
+            }
+            case ShardCommand::AGGREGATES: {
+                const RatingAggregates& stats = cf.getMovieAggregates();
+                vector<MovieAggregate> rows(stats.count.size());
+                for (size_t r = 0; r < rows.size(); r++) rows[r] = {stats.count[r], stats.sum[r], stats.sumSquares[r]};
+                ok = channel.send(request.command, 0, 0, rows);
+                break;
+            }
+            case ShardCommand::SET_AGGREGATES: {
+                vector<MovieAggregate> rows;
+                ok = channel.receiveItems(request, rows);
+                RatingAggregates stats;
+                stats.assign(rows.size());
+                for (size_t r = 0; r < rows.size(); r++) stats.setRow(r, rows[r].count, rows[r].sum, rows[r].sumSquares);
+                cf.setMovieAggregates(std::move(stats));
+                ok = ok && channel.send(request.command);
+                break;
+            }
+            case ShardCommand::SHUTDOWN:
+                return;
+        }
+        if (!ok) return;
+    }
+}
+
+// Coordinator: forks the workers and answers unfiltered recommendation queries
+// with the same result as a single process (up to float summation order and
+// the order of exactly tied neighbours).
+class ShardedRecommender {
+private:
+    CollaborativeFiltering catalog; // movies and global movie aggregates only
+    vector<ShardChannel> shards;
+    vector<pid_t> workers;
+
+    using ProfilePart = CollaborativeFiltering::ProfilePart;
+    using ProfileMean = CollaborativeFiltering::ProfileMean;
+    using SimilarUser = CollaborativeFiltering::SimilarUser;
+    using ScorePart = CollaborativeFiltering::ScorePart;
+
+    bool broadcast(ShardCommand command, int movieId = 0, int k = 0) const {
+        for (const ShardChannel& shard : shards) {
+            if (!shard.send(command, movieId, k)) return false;
+        }
+        return true;
+    }
+
+public:
+    ShardedRecommender() = default;
+    ShardedRecommender(const ShardedRecommender&) = delete;
+    ShardedRecommender& operator=(const ShardedRecommender&) = delete;
+
+    ~ShardedRecommender() { stop(); }
+
+    size_t shardCount() const { return shards.size(); }
+
+    // Fork one worker per shard, load everything and merge the movie aggregates.
+    // Call before this process starts any threads: workers are forked first.
+    bool start(const string& moviesFile, const string& ratingsFile, int numShards, SimilarityMetric metric) {
+        stop();
+        cout.flush();
+        for (int s = 0; s < numShards; s++) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+                cerr << "socketpair failed" << endl;
+                stop();
+                return false;
+            }
+            pid_t pid = fork();
+            if (pid < 0) {
+                cerr << "fork failed" << endl;
+                ::close(fds[0]);
+                ::close(fds[1]);
+                stop();
+                return false;
+            }
+            if (pid == 0) {
+                // Worker: drop the other shards' sockets and keep the loader quiet
+                ::close(fds[0]);
+                for (ShardChannel& other : shards) other.close();
+                int devNull = open("/dev/null", O_WRONLY);
+                if (devNull >= 0) dup2(devNull, STDOUT_FILENO);
+
+                ShardChannel channel(fds[1]);
+                {
+                    CollaborativeFiltering cf;
+                    cf.setSimilarityMetric(metric);
+                    cf.restrictToShard(s, numShards);
+                    if (cf.loadData(moviesFile, ratingsFile)) serveShard(cf, channel);
+                    cout.flush();
+                }
+                _exit(0);
+            }
+            ::close(fds[1]);
+            shards.emplace_back(fds[0]);
+            workers.push_back(pid);
+        }
+
+        // The coordinator loads the catalog while the workers load ratings
+        bool loaded = catalog.loadMovies(moviesFile);
+        catalog.setSimilarityMetric(metric);
+
+        // Movie slots follow movies.csv order in every process, so rows line up
+        RatingAggregates totals;
+        totals.assign(catalog.getMovieCount());
+        vector<MovieAggregate> rows;
+        bool ok = loaded && broadcast(ShardCommand::AGGREGATES);
+        for (const ShardChannel& shard : shards) {
+            if (!ok || !shard.receive(rows) || rows.size() != totals.count.size()) {
+                ok = false;
+                break;
+            }
+            for (size_t r = 0; r < rows.size(); r++) {
+                totals.count[r] += rows[r].count;
+                totals.sum[r] += rows[r].sum;
+                totals.sumSquares[r] += rows[r].sumSquares;
+            }
+        }
+        if (!ok) {
+            cerr << "Sharded load failed" << endl;
+            stop();
+            return false;
+        }
+
+        rows.resize(totals.count.size());
+        for (size_t r = 0; r < rows.size(); r++) {
+            rows[r] = {totals.count[r], totals.sum[r], totals.sumSquares[r]};
+            totals.setRow(r, totals.count[r], totals.sum[r], totals.sumSquares[r]);
+        }
+        vector<char> ack;
+        for (const ShardChannel& shard : shards) ok = ok && shard.send(ShardCommand::SET_AGGREGATES, 0, 0, rows);
+        for (const ShardChannel& shard : shards) ok = ok && shard.receive(ack);
+        catalog.setMovieAggregates(std::move(totals));
+        if (!ok) stop();
+        return ok;
+    }
+
+private:
+    // One scatter/gather round; false as soon as any send or receive fails,
+    // which can leave replies from the other shards unread
+    bool scatterGather(int movieId, int numRecs, RecommendationSink& sink) {
+        // 1. Audience profile: sum the shards' partial sums, then take means
+        size_t numMovies = catalog.getMovieCount();
+        vector<float> sums(numMovies, 0), counts(numMovies, 0);
+        vector<int> touched;
+        vector<ProfilePart> profile;
+        if (!broadcast(ShardCommand::PROFILE, movieId)) return false;
+        for (const ShardChannel& shard : shards) {
+            if (!shard.receive(profile)) return false;
+            for (const ProfilePart& part : profile) {
+                if (counts[part.movieSlot] == 0) touched.push_back(part.movieSlot);
+                sums[part.movieSlot] += part.sum;
+                counts[part.movieSlot] += part.count;
+            }
+        }
+        vector<ProfileMean> means;
+        means.reserve(touched.size());
+        for (int slot : touched) means.push_back({slot, sums[slot] / counts[slot]});
+
+        // 2. Each shard ranks its own raters; the global neighbourhood is the best of those lists
+        int k = CollaborativeFiltering::NEIGHBORHOOD_SIZE;
+        for (const ShardChannel& shard : shards) {
+            if (!shard.send(ShardCommand::SCORE, movieId, k, means)) return false;
+        }
+        TopK best(k);
+        vector<SimilarUser> users;
+        for (const ShardChannel& shard : shards) {
+            if (!shard.receive(users)) return false;
+            for (const SimilarUser& user : users) best.push(user.similarity, user.userId);
+        }
+
+        // 3. Neighbours go back to the shard that owns them for score accumulation
+        vector<vector<SimilarUser>> owned(shards.size());
+        for (const auto& [similarity, userId] : best.sorted()) {
+            if (similarity > 0) owned[static_cast<unsigned>(userId) % shards.size()].push_back({userId, similarity});
+        }
+        for (size_t s = 0; s < shards.size(); s++) {
+            if (!shards[s].send(ShardCommand::ACCUMULATE, movieId, 0, owned[s])) return false;
+        }
+        vector<ScorePart> merged, scores;
+        for (const ShardChannel& shard : shards) {
+            if (!shard.receive(scores)) return false;
+            merged.insert(merged.end(), scores.begin(), scores.end());
+        }
+
+        // 4. Rank and fill from popularity on the coordinator
+        catalog.recommendFromScores(movieId, numRecs, merged, sink);
+        return true;
+    }
+
+public:
+    // Scatter/gather version of CollaborativeFiltering::getRecommendations.
+    // A failed round leaves the channels out of step with the workers, so the
+    // workers are stopped and every later call fails fast.
+    bool recommend(int movieId, int numRecs, RecommendationSink& sink) {
+        if (shards.empty()) return false;
+        if (!scatterGather(movieId, numRecs, sink)) {
+            cerr << "Shard query failed; stopping the shard workers" << endl;
+            stop();
+            return false;
+        }
+        return true;
+    }
+
+    vector<Recommendation> recommend(int movieId, int numRecs = 5) {
+        VectorSink sink;
+        recommend(movieId, numRecs, sink);
+        return sink.results;
+    }
+
+    vector<int> getAllMovieIds() { return catalog.getAllMovieIds(); }
+
+    void stop() {
+        for (const ShardChannel& shard : shards) shard.send(ShardCommand::SHUTDOWN);
+        for (ShardChannel& shard : shards) shard.close();
+        for (pid_t pid : workers) waitpid(pid, nullptr, 0);
+        shards.clear();
+        workers.clear();
+    }
+};
+
+// Latency against shard count. Each configuration runs in a fresh child
+// process so its workers are forked before any thread exists. Queries go one
+// at a time, so the serial rate is about 1 / average latency, not the
+// throughput of several queries in flight.
+inline void runShardBenchmark(const string& moviesFile, const string& ratingsFile, const vector<int>& shardCounts,
+                              int queries, SimilarityMetric metric, uint32_t seed = 42) {
+    struct ShardResult {
+        bool ok;
+        int failedQueries;
+        double loadSeconds;
+        double avgMicros;
+        double p99Micros;
+        double serialQps;
+    };
+
+    cout << "Sharded serving benchmark (metric " << similarityMetricName(metric) << ", " << queries
+         << " queries, seed " << seed << ")" << endl;
+    cout << right << setw(8) << "Shards" << setw(10) << "Load (s)" << setw(12) << "Avg (us)" << setw(12)
+         << "p99 (us)" << setw(13) << "Serial QPS" << endl;
+
+    for (int numShards : shardCounts) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            cerr << "pipe failed" << endl;
+            return;
+        }
+        cout.flush();
+        pid_t pid = fork();
+        if (pid < 0) {
+            cerr << "fork failed" << endl;
+            return;
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            ShardResult result{false, 0, 0, 0, 0, 0};
+            {
+                auto startTime = chrono::steady_clock::now();
+                ShardedRecommender recommender;
+                if (recommender.start(moviesFile, ratingsFile, numShards, metric)) {
+                    auto loaded = chrono::steady_clock::now();
+                    result.loadSeconds = chrono::duration<double>(loaded - startTime).count();
+
+                    // The same seeded sample for every shard count
+                    vector<int> movieIds = recommender.getAllMovieIds();
+                    mt19937 gen(seed);
+                    vector<double> latencies;
+                    for (int q = 0; q < queries && !movieIds.empty(); q++) {
+                        int movieId = movieIds[gen() % movieIds.size()];
+                        VectorSink sink;
+                        auto queryStart = chrono::steady_clock::now();
+                        if (!recommender.recommend(movieId, 5, sink)) {
+                            result.failedQueries++;
+                            continue;
+                        }
+                        latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now()
+                                                                            - queryStart).count());
+                    }
+                    double total = chrono::duration<double>(chrono::steady_clock::now() - loaded).count();
+                    if (!latencies.empty()) {
+                        sort(latencies.begin(), latencies.end());
+                        for (double t : latencies) result.avgMicros += t;
+                        result.avgMicros /= latencies.size();
+                        result.p99Micros = latencies[min(latencies.size() - 1, latencies.size() * 99 / 100)];
+                        result.serialQps = total > 0 ? latencies.size() / total : 0;
+                    }
+                    result.ok = result.failedQueries == 0;
+                }
+            }
+            cout.flush();
+            ssize_t written = write(fds[1], &result, sizeof(result));
+            _exit(written == static_cast<ssize_t>(sizeof(result)) ? 0 : 1);
+        }
+
+        close(fds[1]);
+        ShardResult result{false, 0, 0, 0, 0, 0};
+        ssize_t got = read(fds[0], &result, sizeof(result));
+        close(fds[0]);
+        waitpid(pid, nullptr, 0);
+
+        cout << right << setw(8) << numShards;
+        if (got != static_cast<ssize_t>(sizeof(result)) || !result.ok) {
+            cout << "  failed";
+            if (got == static_cast<ssize_t>(sizeof(result)) && result.failedQueries > 0) {
+                cout << " (" << result.failedQueries << " of " << queries << " queries)";
+            }
+            cout << endl;
+            continue;
+        }
+        cout << fixed << setprecision(2) << setw(10) << result.loadSeconds << setprecision(1) << setw(12)
+             << result.avgMicros << setw(12) << result.p99Micros << setw(13) << result.serialQps << endl;
+        cout.unsetf(ios::fixed);
+    }
+}
+
+#endif //SHARDEDSERVING_H
@@ -0,0 +1,153 @@
+#ifndef SIMILARITY_H
+#define SIMILARITY_H
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+// Similarity policies for the collaborative filtering scan. Each rater's
+// ratings are compared against the target movie's audience profile:
+//   x = the rater's rating of a movie
+//   y = the audience's mean rating of that movie
+//   itemMean = that movie's global mean rating
+// A policy opens a small State with start(), folds every co-rated movie into
+// it with accumulate(), and turns it into a score in finish(). Everything is
+// static, so each metric compiles into its own fully inlined loop.
+
+// What the scan knows about the rater and profile before the per-movie loop
+struct SimilarityInput {
+    int n;               // co-rated movies (the target movie is excluded)
+    double sumX;         // rater's rating sum over those movies
+    double sumXX;        // rater's sum of squared ratings
+    float userMean;      // rater's mean over all ratings
+    size_t profileLiked; // profile movies whose audience mean is a "like"
+};
+
+// Ratings at or above this count as a "like" for set-based metrics
+constexpr float LIKE_THRESHOLD = 3.5f;
+
+struct PearsonSimilarity {
+    struct State { double sumY = 0, sumYY = 0, sumXY = 0; };
+
+    static State start(const SimilarityInput&) { return State(); }
+
+    static void accumulate(State& s, float x, float y, float) {
+        s.sumY += y;
+        s.sumYY += static_cast<double>(y) * y;
+        s.sumXY += static_cast<double>(x) * y;
+    }
+
+    // Mean-centered sums via the computational form: sum(xy) - sum(x)sum(y)/n
+    static float finish(const State& s, const SimilarityInput& in) {
+        double numerator = s.sumXY - in.sumX * s.sumY / in.n;
+        double denom1 = in.sumXX - in.sumX * in.sumX / in.n;
+        double denom2 = s.sumYY - s.sumY * s.sumY / in.n;
+        if (denom1 <= 1e-9 || denom2 <= 1e-9) return 0.0f;
+        return static_cast<float>(numerator / sqrt(denom1 * denom2));
+    }
+};
+
+struct CosineSimilarity {
+    struct State { double sumYY = 0, sumXY = 0; };
+
+    static State start(const SimilarityInput&) { return State(); }
+
+    static void accumulate(State& s, float x, float y, float) {
+        s.sumYY += static_cast<double>(y) * y;
+        s.sumXY += static_cast<double>(x) * y;
+    }
+
+    static float finish(const State& s, const SimilarityInput& in) {
+        if (in.sumXX <= 0 || s.sumYY <= 0) return 0.0f;
+        return static_cast<float>(s.sumXY / sqrt(in.sumXX * s.sumYY));
+    }
+};
+
+// Rater centered on their own mean, audience centered on each movie's global mean
+struct AdjustedCosineSimilarity {
+    struct State { double sumAB = 0, sumAA = 0, sumBB = 0; float userMean = 0; };
+
+    static State start(const SimilarityInput& in) {
+        State s;
+        s.userMean = in.userMean;
+        return s;
+    }
+
+    static void accumulate(State& s, float x, float y, float itemMean) {
+        double a = x - s.userMean;
+        double b = y - itemMean;
+        s.sumAB += a * b;
+        s.sumAA += a * a;
+        s.sumBB += b * b;
+    }
+
+    static float finish(const State& s, const SimilarityInput&) {
+        if (s.sumAA <= 1e-9 || s.sumBB <= 1e-9) return 0.0f;
+        return static_cast<float>(s.sumAB / sqrt(s.sumAA * s.sumBB));
+    }
+};
+
+// Overlap of "liked" sets: movies the rater liked vs movies the audience liked
+struct JaccardSimilarity {
+    struct State { size_t both = 0, userLiked = 0; };
+
+    static State start(const SimilarityInput&) { return State(); }
+
+    static void accumulate(State& s, float x, float y, float) {
+        bool userLikes = x >= LIKE_THRESHOLD;
+        s.userLiked += userLikes;
+        s.both += userLikes && y >= LIKE_THRESHOLD;
+    }
+
+    static float finish(const State& s, const SimilarityInput& in) {
+        size_t unionSize = s.userLiked + in.profileLiked - s.both;
+        return unionSize == 0 ? 0.0f : static_cast<float>(s.both) / unionSize;
+    }
+};
+
+// Overlap policies: the minimum co-rated count and how the score is damped
+template <int MinCommon>
+struct MinimumOverlap {
+    static bool accept(int n) { return n >= MinCommon; }
+    static float shrink(float similarity, int) { return similarity; }
+};
+
+// Pulls scores from small overlaps towards zero: sim * n / (n + Lambda)
+template <int MinCommon, int Lambda>
+struct ShrunkOverlap {
+    static bool accept(int n) { return n >= MinCommon; }
+    static float shrink(float similarity, int n) { return similarity * n / (n + Lambda); }
+};
+
+// Runtime selector for the menu / command line
+enum class SimilarityMetric { PEARSON, SHRUNK_PEARSON, COSINE, ADJUSTED_COSINE, JACCARD };
+
+constexpr SimilarityMetric ALL_SIMILARITY_METRICS[] = {
+    SimilarityMetric::PEARSON, SimilarityMetric::SHRUNK_PEARSON, SimilarityMetric::COSINE,
+    SimilarityMetric::ADJUSTED_COSINE, SimilarityMetric::JACCARD
+};
+
+inline string similarityMetricName(SimilarityMetric metric) {
+    switch (metric) {
+        case SimilarityMetric::PEARSON: return "pearson";
+        case SimilarityMetric::SHRUNK_PEARSON: return "shrunk-pearson";
+        case SimilarityMetric::COSINE: return "cosine";
+        case SimilarityMetric::ADJUSTED_COSINE: return "adjusted-cosine";
+        case SimilarityMetric::JACCARD: return "jaccard";
+    }
+    return "pearson";
+}
+
+// Parse a metric name; returns false if it is not recognised
+inline bool parseSimilarityMetric(const string& name, SimilarityMetric& metric) {
+    for (SimilarityMetric m : ALL_SIMILARITY_METRICS) {
+        if (similarityMetricName(m) == name) {
+            metric = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif //SIMILARITY_H
@@ -0,0 +1,328 @@
+#ifndef TAGINDEX_H
+#define TAGINDEX_H
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <queue>
+#include <cmath>
+#include <cstdint>
+#include <cctype>
+#include "BitmapIndex.h"
+
+using namespace std;
+
+// TF-IDF content vectors (tags + genres) stored in an inverted index.
+// Documents are movies; terms are normalized tags and "genre:<name>" tokens.
+// Doc ids follow addMovie order, so registering movies in slot order lets
+// slot-space filter bitmaps address documents directly.
+class TagIndex {
+private:
+    unordered_map<string, int> termIds;   // term -> term index
+    unordered_map<int, int> docOf;        // movieId -> doc index
+    vector<int> docMovieIds;              // doc index -> movieId
+
+    // Raw (doc, term) occurrences collected while loading, folded by build()
+    vector<pair<uint32_t, uint32_t>> occurrences;
+
+    // Per-document normalized vectors (CSR, terms ascending)
+    vector<uint32_t> docOffsets;
+    vector<uint32_t> docTerms;
+    vector<float> docWeights;
+
+    // Posting lists (CSR, docs ascending) with per-term max weight for pruning
+    vector<uint32_t> postingOffsets;
+    vector<uint32_t> postingDocs;
+    vector<float> postingWeights;
+    vector<float> termMaxWeight;
+
+    int termIdFor(const string& term) {
+        auto it = termIds.find(term);
+        if (it != termIds.end()) return it->second;
+        int id = static_cast<int>(termIds.size());
+        termIds.emplace(term, id);
+        return id;
+    }
+
+    int docIdFor(int movieId) {
+        auto it = docOf.find(movieId);
+        if (it != docOf.end()) return it->second;
+        int id = static_cast<int>(docMovieIds.size());
+        docOf.emplace(movieId, id);
+        docMovieIds.push_back(movieId);
+        return id;
+    }
+
+    // Lowercase and trim so "Pixar", " pixar" and "PIXAR" are one term
+    static string normalizeTag(const string& tag) {
+        size_t begin = 0, end = tag.size();
+        while (begin < end && isspace(static_cast<unsigned char>(tag[begin]))) begin++;
+        while (end > begin && isspace(static_cast<unsigned char>(tag[end - 1]))) end--;
+        string out = tag.substr(begin, end - begin);
+        transform(out.begin(), out.end(), out.begin(), ::tolower);
+        return out;
+    }
+
+    // Cursor over one query term's posting list
+    struct Cursor {
+        const uint32_t* docs;
+        const float* weights;
+        size_t pos, len;
+        float queryWeight;
+        float upperBound;
+
+        uint32_t doc() const { return pos < len ? docs[pos] : UINT32_MAX; }
+
+        // Galloping search to the first posting with doc >= target
+        void advanceTo(uint32_t target) {
+            if (pos >= len || docs[pos] >= target) return;
+            size_t step = 1, lo = pos, hi = pos + 1;
+            while (hi < len && docs[hi] < target) {
+                lo = hi;
+                step <<= 1;
+                hi = pos + step;
+            }
+            if (hi > len) hi = len;
+            pos = lower_bound(docs + lo, docs + hi, target) - docs;
+        }
+    };
+
+public:
+    // Register a movie and its genres as a document
+    void addMovie(int movieId, const vector<string>& genres) {
+        uint32_t doc = docIdFor(movieId);
+        for (const auto& g : genres) {
+            if (g == "(no genres listed)") continue;
+            occurrences.push_back({doc, static_cast<uint32_t>(termIdFor("genre:" + g))});
+        }
+    }
+
+    // Record one user-applied tag on a registered movie
+    void addTag(int movieId, const string& tag) {
+        auto it = docOf.find(movieId);
+        if (it == docOf.end()) return;
+        string term = normalizeTag(tag);
+        if (term.empty()) return;
+        uint32_t doc = it->second;
+        occurrences.push_back({doc, static_cast<uint32_t>(termIdFor(term))});
+    }
+
+    // Fold raw occurrences into normalized TF-IDF vectors and posting lists
+    void build() {
+        sort(occurrences.begin(), occurrences.end());
+
+        size_t numDocs = docMovieIds.size();
+        size_t numTerms = termIds.size();
+
+        // Document frequency per term
+        vector<uint32_t> df(numTerms, 0);
+        for (size_t i = 0; i < occurrences.size(); i++) {
+            if (i == 0 || occurrences[i] != occurrences[i - 1]) df[occurrences[i].second]++;
+        }
+
+        // Per-document vectors: (1 + log tf) * idf, L2-normalized
+        docOffsets.assign(numDocs + 1, 0);
+        docTerms.clear();
+        docWeights.clear();
+        size_t i = 0;
+        for (uint32_t doc = 0; doc < numDocs; doc++) {
+            docOffsets[doc] = static_cast<uint32_t>(docTerms.size());
+            float norm = 0;
+            while (i < occurrences.size() && occurrences[i].first == doc) {
+                uint32_t term = occurrences[i].second;
+                size_t tf = 0;
+                while (i < occurrences.size() && occurrences[i].first == doc && occurrences[i].second == term) {
+                    tf++;
+                    i++;
+                }
+                float idf = log(static_cast<float>(numDocs) / df[term]);
+                float w = (1.0f + log(static_cast<float>(tf))) * idf;
+                if (w <= 0) continue; // term present in every document carries no signal
+                docTerms.push_back(term);
+                docWeights.push_back(w);
+                norm += w * w;
+            }
+            if (norm > 0) {
+                float inv = 1.0f / sqrt(norm);
+                for (size_t j = docOffsets[doc]; j < docWeights.size(); j++) docWeights[j] *= inv;
+            }
+        }
+        docOffsets[numDocs] = static_cast<uint32_t>(docTerms.size());
+        occurrences.clear();
+        occurrences.shrink_to_fit();
+
+        // Invert: count postings per term, then fill in doc order so lists stay sorted
+        postingOffsets.assign(numTerms + 1, 0);
+        for (uint32_t term : docTerms) postingOffsets[term + 1]++;
+        for (size_t t = 0; t < numTerms; t++) postingOffsets[t + 1] += postingOffsets[t];
+
+        postingDocs.resize(docTerms.size());
+        postingWeights.resize(docTerms.size());
+        termMaxWeight.assign(numTerms, 0);
+        vector<uint32_t> fill(postingOffsets.begin(), postingOffsets.end() - 1);
+        for (uint32_t doc = 0; doc < numDocs; doc++) {
+            for (uint32_t j = docOffsets[doc]; j < docOffsets[doc + 1]; j++) {
+                uint32_t term = docTerms[j];
+                uint32_t slot = fill[term]++;
+                postingDocs[slot] = doc;
+                postingWeights[slot] = docWeights[j];
+                termMaxWeight[term] = max(termMaxWeight[term], docWeights[j]);
+            }
+        }
+    }
+
+    // Document of movieId, or -1 if it was never registered
+    int docFor(int movieId) const {
+        auto it = docOf.find(movieId);
+        return it == docOf.end() ? -1 : it->second;
+    }
+
+    // Document a's vector spread over every term, so many documents can be
+    // scored against it with dot() instead of merging term lists
+    void expand(uint32_t a, vector<float>& dense) const {
+        dense.assign(termIds.size(), 0.0f);
+        if (docOffsets.empty()) return;
+        for (uint32_t i = docOffsets[a]; i < docOffsets[a + 1]; i++) dense[docTerms[i]] = docWeights[i];
+    }
+
+    // Cosine similarity of document b to an expanded document
+    float dot(const vector<float>& dense, uint32_t b) const {
+        if (docOffsets.empty()) return 0;
+        float sum = 0;
+        for (uint32_t j = docOffsets[b]; j < docOffsets[b + 1]; j++) sum += dense[docTerms[j]] * docWeights[j];
+        return sum;
+    }
+
+    size_t numDocuments() const { return docMovieIds.size(); }
+    size_t numTerms() const { return termIds.size(); }
+    size_t numPostings() const { return postingDocs.size(); }
+
+    // Top-N movies by cosine similarity to movieId, using MaxScore pruning:
+    // terms whose combined upper bound cannot lift a document past the current
+    // N-th best score are only probed for documents found via the other terms.
+    // With docFilter, only those documents are scored; a selective filter
+    // drives the scan itself instead of the posting lists. Only documents
+    // scoring above minScore are returned, and a floor prunes from the start
+    // as if the top-N were already full.
+    vector<pair<int, float>> topN(int movieId, int n, const RoaringBitmap* docFilter = nullptr,
+                                  float minScore = 0) const {
+        auto it = docOf.find(movieId);
+        if (it == docOf.end() || n <= 0 || docOffsets.empty()) return {};
+        uint32_t self = it->second;
+
+        vector<Cursor> cursors;
+        for (uint32_t j = docOffsets[self]; j < docOffsets[self + 1]; j++) {
+            uint32_t term = docTerms[j];
+            uint32_t begin = postingOffsets[term];
+            Cursor c{postingDocs.data() + begin, postingWeights.data() + begin, 0,
+                     postingOffsets[term + 1] - begin, docWeights[j],
+                     docWeights[j] * termMaxWeight[term]};
+            cursors.push_back(c);
+        }
+        if (cursors.empty()) return {};
+
+        // Ascending upper bound; prefix sums give the best case for the first i+1 terms
+        sort(cursors.begin(), cursors.end(),
+             [](const Cursor& a, const Cursor& b) { return a.upperBound < b.upperBound; });
+        vector<float> prefixBound(cursors.size());
+        float running = 0;
+        for (size_t t = 0; t < cursors.size(); t++) {
+            running += cursors[t].upperBound;
+            prefixBound[t] = running;
+        }
+
+        // Min-heap of the current top-N (score, doc); a document must beat
+        // threshold (the floor, then the N-th best score) to enter
+        ScoreHeap heap;
+        float threshold = max(minScore, 0.0f);
+        size_t firstEssential = 0;
+        while (firstEssential < cursors.size() && prefixBound[firstEssential] <= threshold) firstEssential++;
+
+        size_t totalPostings = 0;
+        for (const auto& c : cursors) totalPostings += c.len;
+
+        if (docFilter && docFilter->cardinality() < totalPostings) {
+            // Filter-driven: visit only candidate docs, galloping every list forward
+            docFilter->forEach([&](uint32_t doc) {
+                if (doc == self) return;
+                if (prefixBound.back() <= threshold) return;
+
+                float score = 0;
+                for (size_t t = cursors.size(); t-- > 0;) {
+                    if (score + prefixBound[t] <= threshold) break;
+                    cursors[t].advanceTo(doc);
+                    if (cursors[t].doc() == doc) {
+                        score += cursors[t].queryWeight * cursors[t].weights[cursors[t].pos];
+                    }
+                }
+                if (score <= threshold) return;
+
+                if (heap.size() == static_cast<size_t>(n)) heap.pop();
+                heap.push({score, doc});
+                if (heap.size() == static_cast<size_t>(n)) threshold = heap.top().first;
+            });
+            return drainHeap(heap);
+        }
+
+        while (true) {
+            uint32_t doc = UINT32_MAX;
+            for (size_t t = firstEssential; t < cursors.size(); t++) doc = min(doc, cursors[t].doc());
+            if (doc == UINT32_MAX) break;
+
+            // Excluded docs are stepped over without being scored
+            if (docFilter && !docFilter->contains(doc)) {
+                for (size_t t = firstEssential; t < cursors.size(); t++) {
+                    if (cursors[t].doc() == doc) cursors[t].pos++;
+                }
+                continue;
+            }
+
+            float score = 0;
+            for (size_t t = firstEssential; t < cursors.size(); t++) {
+                if (cursors[t].doc() == doc) {
+                    score += cursors[t].queryWeight * cursors[t].weights[cursors[t].pos];
+                    cursors[t].pos++;
+                }
+            }
+
+            // Non-essential terms, strongest first, until the bound says stop
+            for (size_t t = firstEssential; t-- > 0;) {
+                if (score + prefixBound[t] <= threshold) break;
+                cursors[t].advanceTo(doc);
+                if (cursors[t].doc() == doc) {
+                    score += cursors[t].queryWeight * cursors[t].weights[cursors[t].pos];
+                }
+            }
+
+            if (doc == self || score <= threshold) continue;
+            if (heap.size() == static_cast<size_t>(n)) heap.pop();
+            heap.push({score, doc});
+
+            if (heap.size() == static_cast<size_t>(n)) {
+                threshold = heap.top().first;
+                while (firstEssential < cursors.size() && prefixBound[firstEssential] <= threshold) {
+                    firstEssential++;
+                }
+            }
+        }
+
+        return drainHeap(heap);
+    }
+
+private:
+    using ScoreHeap = priority_queue<pair<float, uint32_t>, vector<pair<float, uint32_t>>, greater<>>;
+
+    // Empty a top-N min-heap into (movieId, score) pairs, best first
+    vector<pair<int, float>> drainHeap(ScoreHeap& heap) const {
+        vector<pair<int, float>> results;
+        results.reserve(heap.size());
+        while (!heap.empty()) {
+            results.push_back({docMovieIds[heap.top().second], heap.top().first});
+            heap.pop();
+        }
+        reverse(results.begin(), results.end());
+        return results;
+    }
+};
+
+#endif //TAGINDEX_H
@@ -0,0 +1,62 @@
+#ifndef TOPK_H
+#define TOPK_H
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <cstddef>
+
+using namespace std;
+
+// Bounded top-k selection over (score, id) pairs. A min-heap holds the k best
+// seen so far, so each push is O(log k) and nothing outside the top k is kept.
+// Ties rank the larger id first, matching priority_queue<pair<float, int>>.
+class TopK {
+private:
+    size_t k;
+    vector<pair<float, int>> heap; // min-heap under greater<>
+
+public:
+    explicit TopK(size_t limit, size_t expected = 0) : k(limit) {
+        heap.reserve(min(limit, expected));
+    }
+
+    size_t size() const { return heap.size(); }
+    bool full() const { return heap.size() >= k; }
+
+    // Smallest score still in the top k (only meaningful once full)
+    float threshold() const { return heap.empty() ? 0.0f : heap.front().first; }
+
+    void push(float score, int id) {
+        if (k == 0) return;
+        pair<float, int> item(score, id);
+        if (heap.size() < k) {
+            heap.push_back(item);
+            push_heap(heap.begin(), heap.end(), greater<>());
+        } else if (item > heap.front()) {
+            pop_heap(heap.begin(), heap.end(), greater<>());
+            heap.back() = item;
+            push_heap(heap.begin(), heap.end(), greater<>());
+        }
+    }
+
+    void merge(const TopK& other) {
+        for (const auto& [score, id] : other.heap) push(score, id);
+    }
+
+    // Unordered contents, for callers that only sort a prefix; empties the heap
+    vector<pair<float, int>> release() {
+        vector<pair<float, int>> out = std::move(heap);
+        heap.clear();
+        return out;
+    }
+
+    // Best first
+    vector<pair<float, int>> sorted() const {
+        vector<pair<float, int>> out(heap);
+        sort(out.begin(), out.end(), greater<>());
+        return out;
+    }
+};
+
+#endif //TOPK_H
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <string>
+#include <filesystem>
+#include <chrono>
+#include "DatasetGenerator.h"
+
+using namespace std;
+
+// Writes a synthetic MovieLens-format data set:
+//   MovieGen [--scale=X] [--movies=N] [--users=N] [--ratings=N] [--tags=N]
+//            [--popularity-skew=S] [--activity-skew=S] [--seed=N] [--out=DIR]
+// --scale=1 matches the size of MovieLens latest-small; explicit sizes override it.
+int main(int argc, char* argv[]) {
+    DatasetConfig config;
+    string outDir = ".";
+    uint32_t seed = config.seed;
+
+    // --scale first, so explicit sizes can override the scaled defaults
+    string key, value;
+    try {
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg.rfind("--seed=", 0) != 0) continue;
+            key = "--seed";
+            value = arg.substr(7);
+            seed = static_cast<uint32_t>(stoul(value));
+        }
+        config.seed = seed;
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg.rfind("--scale=", 0) != 0) continue;
+            key = "--scale";
+            value = arg.substr(8);
+            config = DatasetConfig::scaled(stod(value), seed);
+        }
+    } catch (...) {
+        cerr << "Invalid value for " << key << ": " << value << endl;
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        key = arg.substr(0, eq);
+        value = eq == string::npos ? "" : arg.substr(eq + 1);
+        try {
+            if (key == "--movies") config.numMovies = stoi(value);
+            else if (key == "--users") config.numUsers = stoi(value);
+            else if (key == "--ratings") config.numRatings = stoull(value);
+            else if (key == "--tags") config.numTags = stoull(value);
+            else if (key == "--popularity-skew") config.popularitySkew = stod(value);
+            else if (key == "--activity-skew") config.activitySkew = stod(value);
+            else if (key == "--out") outDir = value;
+            else if (key != "--scale" && key != "--seed") {
+                cerr << "Unknown option " << arg << endl;
+                return 1;
+            }
+        } catch (...) {
+            cerr << "Invalid value for " << key << ": " << value << endl;
+            return 1;
+        }
+    }
+    if (config.numMovies <= 0 || config.numUsers <= 0 || config.numRatings < static_cast<size_t>(config.numUsers)) {
+        cerr << "Need at least one movie and user, and at least one rating per user" << endl;
+        return 1;
+    }
+
+    filesystem::create_directories(outDir);
+    auto startTime = chrono::high_resolution_clock::now();
+    DatasetStats stats;
+    if (!generateDataset(config, outDir, &stats)) {
+        cerr << "Error writing data set to " << outDir << endl;
+        return 1;
+    }
+    auto seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - startTime).count();
+
+    cout << "Wrote " << stats.movies << " movies, " << stats.users << " users, " << stats.ratings
+         << " ratings and " << stats.tags << " tags to " << outDir << " in " << seconds << " s (seed "
+         << config.seed << ")" << endl;
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include "Filtering.h"
 #include "RBTree.h"
 #include "RecommendationSystem.h"
+#include "ScalingBenchmark.h"
+#include "ShardedServing.h"
 
 
 void printMenu() {
@@ -8,18 +10,118 @@ void printMenu() {
     cout << "1. Get recommendations by movie title\n";
     cout << "2. Run performance benchmark\n";
     cout << "3. Test Red-Black Tree operations\n";
-    cout << "4. Exit\n";
+    cout << "4. Get recommendations within a latency budget\n";
+    cout << "5. Get recommendations by IMDb/TMDB id\n";
+    cout << "6. Browse the movie catalog\n";
+    cout << "7. Get filtered recommendations (genre, year, rating count)\n";
+    cout << "8. Show most popular movies\n";
+    cout << "9. Select similarity metric\n";
+    cout << "10. Get hybrid recommendations (collaborative + content + popularity)\n";
+    cout << "11. Exit\n";
     cout << "Enter your choice: ";
 }
 
-int main() {
+// Comma-separated list of the metric names accepted by --metric and the menu
+string metricNames() {
+    string names;
+    for (SimilarityMetric metric : ALL_SIMILARITY_METRICS) {
+        if (!names.empty()) names += ", ";
+        names += similarityMetricName(metric);
+    }
+    return names;
+}
+
+// "CF,CONTENT,POPULARITY" blend weights, e.g. "0.6,0.3,0.1"
+bool parseHybridWeights(const string& text, HybridWeights& weights) {
+    HybridWeights parsed;
+    if (sscanf(text.c_str(), "%f,%f,%f", &parsed.collaborative, &parsed.content, &parsed.popularity) != 3
+        || parsed.collaborative < 0 || parsed.content < 0 || parsed.popularity < 0) {
+        return false;
+    }
+    weights = parsed;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    // Optional: --metric=<name> picks the collaborative filtering similarity,
+    // --memory-budget=<MB> serves ratings from disk through a cache of that size,
+    // --scaling[=1,10,100] benchmarks synthetic data sets of those sizes and exits,
+    // --shards[=1,2,4] benchmarks multi-process sharded serving and exits,
+    // --hybrid-weights=CF,CONTENT,POPULARITY sets the hybrid recommender's blend
+    SimilarityMetric metric = SimilarityMetric::PEARSON;
+    size_t memoryBudgetMb = 0;
+    vector<double> scales;
+    uint32_t seed = 42;
+    string scalingDir = "synthetic";
+    vector<int> shardCounts;
+    HybridWeights hybridWeights;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--metric=", 0) == 0) {
+            if (!parseSimilarityMetric(arg.substr(9), metric)) {
+                cerr << "Unknown metric " << arg.substr(9) << " (expected one of: " << metricNames() << ")\n";
+                return 1;
+            }
+        } else if (arg.rfind("--memory-budget=", 0) == 0) {
+            memoryBudgetMb = strtoul(arg.c_str() + 16, nullptr, 10);
+            if (memoryBudgetMb == 0) {
+                cerr << "Invalid memory budget " << arg.substr(16) << " (expected a size in MB)\n";
+                return 1;
+            }
+        } else if (arg == "--scaling" || arg.rfind("--scaling=", 0) == 0) {
+            stringstream list(arg == "--scaling" ? "1,10,100" : arg.substr(10));
+            string item;
+            while (getline(list, item, ',')) {
+                double scale = atof(item.c_str());
+                if (scale <= 0) {
+                    cerr << "Invalid scale " << item << "\n";
+                    return 1;
+                }
+                scales.push_back(scale);
+            }
+        } else if (arg == "--shards" || arg.rfind("--shards=", 0) == 0) {
+            stringstream list(arg == "--shards" ? "1,2,4" : arg.substr(9));
+            string item;
+            while (getline(list, item, ',')) {
+                int count = atoi(item.c_str());
+                if (count <= 0) {
+                    cerr << "Invalid shard count " << item << "\n";
+                    return 1;
+                }
+                shardCounts.push_back(count);
+            }
+        } else if (arg.rfind("--hybrid-weights=", 0) == 0) {
+            if (!parseHybridWeights(arg.substr(17), hybridWeights)) {
+                cerr << "Invalid hybrid weights " << arg.substr(17) << " (expected three non-negative numbers, e.g. 0.6,0.3,0.1)\n";
+                return 1;
+            }
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            seed = static_cast<uint32_t>(strtoul(arg.c_str() + 7, nullptr, 10));
+        } else if (arg.rfind("--scaling-dir=", 0) == 0) {
+            scalingDir = arg.substr(14);
+        }
+    }
+
+    if (!scales.empty()) {
+        runScalingBenchmark(scales, seed, scalingDir, metric, memoryBudgetMb * 1024 * 1024);
+        return 0;
+    }
+    if (!shardCounts.empty()) {
+        runShardBenchmark("movies.csv", "ratings.csv", shardCounts, 100, metric, seed);
+        return 0;
+    }
+
     RecommendationSystem sys;
-    if (!sys.initialize("movies.csv", "ratings.csv")) {
+    sys.enableOutOfCore(memoryBudgetMb * 1024 * 1024);
+    if (!sys.initialize("movies.csv", "ratings.csv", "tags.csv", "links.csv")) {
         return 1;
     }
+    sys.setSimilarityMetric(metric);
+    sys.setHybridWeights(hybridWeights);
 
     int choice;
     while (true) {
+        sys.printLoadStatus();
         printMenu();
         cin >> choice;
         cin.ignore();
@@ -33,6 +135,83 @@ int main() {
         } else if (choice == 3) {
             sys.testTreeOperations();
         } else if (choice == 4) {
+            cout << "Enter a movie title: ";
+            string title;
+            getline(cin, title);
+            cout << "Enter a latency budget in ms: ";
+            double budgetMs;
+            cin >> budgetMs;
+            cin.ignore();
+            sys.getRecommendationsByTitle(title, static_cast<long long>(budgetMs * 1000));
+        } else if (choice == 5) {
+            cout << "Id type (1 = IMDb, 2 = TMDB): ";
+            int kind;
+            cin >> kind;
+            cout << "Enter the id: ";
+            int externalId;
+            cin >> externalId;
+            cin.ignore();
+            sys.printRecommendationsByExternalId(kind == 2 ? ExternalIdKind::TMDB : ExternalIdKind::IMDB, externalId);
+        } else if (choice == 6) {
+            cout << "Enter a page number: ";
+            int page;
+            cin >> page;
+            cin.ignore();
+            sys.listCatalogPage(page);
+        } else if (choice == 7) {
+            cout << "Enter a movie title: ";
+            string title;
+            getline(cin, title);
+
+            MovieFilter filter;
+            cout << "Required genres separated by '|' (blank for any): ";
+            string genres;
+            getline(cin, genres);
+            stringstream genreStream(genres);
+            string genre;
+            while (getline(genreStream, genre, '|')) {
+                if (!genre.empty()) filter.genres.push_back(genre);
+            }
+
+            cout << "Year range as FROM-TO (blank for any): ";
+            string years;
+            getline(cin, years);
+            if (sscanf(years.c_str(), "%d-%d", &filter.minYear, &filter.maxYear) != 2) {
+                filter.minYear = INT_MIN;
+                filter.maxYear = INT_MAX;
+            }
+
+            cout << "Minimum number of ratings (0 for any): ";
+            cin >> filter.minRatings;
+            cin.ignore();
+            sys.getFilteredRecommendationsByTitle(title, filter);
+        } else if (choice == 8) {
+            sys.listPopularMovies();
+        } else if (choice == 9) {
+            cout << "Metric (" << metricNames() << "): ";
+            string name;
+            getline(cin, name);
+            if (parseSimilarityMetric(name, metric)) {
+                sys.setSimilarityMetric(metric);
+            } else {
+                cout << "Unknown metric: " << name << endl;
+            }
+        } else if (choice == 10) {
+            cout << "Enter a movie title: ";
+            string title;
+            getline(cin, title);
+            cout << "Blend weights as CF,CONTENT,POPULARITY (blank to keep current): ";
+            string weights;
+            getline(cin, weights);
+            if (!weights.empty()) {
+                if (parseHybridWeights(weights, hybridWeights)) {
+                    sys.setHybridWeights(hybridWeights);
+                } else {
+                    cout << "Invalid weights, keeping the current blend" << endl;
+                }
+            }
+            sys.getHybridRecommendationsByTitle(title);
+        } else if (choice == 11) {
             cout << "Thank you for using MovieManaics, goodbye!\n";
             break;
         } else {